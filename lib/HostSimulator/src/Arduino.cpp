@@ -0,0 +1,188 @@
+// Arduino.cpp
+#include "Arduino.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <random>
+#include <thread>
+
+#include "MockInfluxDB.h"
+#include "MockMqttBroker.h"
+#include "SimulationConfig.h"
+#include "SoakStatistics.h"
+
+HardwareSerial Serial;
+SimulationConfig simulationConfig;
+
+// Provided by the firmware
+void setup();
+void loop();
+extern bool cloudPublishingEnabled;
+extern unsigned long publishRounds;
+void getInfluxDBSinkBacklog(unsigned long& published, unsigned long& dropped, unsigned long& queued);
+// Only present in ALLOC_TRACKING builds
+extern "C" unsigned long allocationTrackerSteadyStateViolations() __attribute__((weak));
+
+static const auto startTime = std::chrono::steady_clock::now();
+static std::atomic<unsigned long> skippedMs{0};
+
+unsigned long millis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count() + skippedMs;
+}
+
+unsigned long micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count() + skippedMs * 1000;
+}
+
+void advanceMillis(unsigned long ms) {
+    skippedMs += ms;
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+uint32_t esp_random() {
+    static std::random_device device;
+    return device();
+}
+
+bool parseSimulationArguments(int argc, char** argv) {
+    bool positionGiven = false;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr) {
+            return false;
+        }
+        if (strcmp(option, "--gateway") == 0) {
+            simulationConfig.gatewayIndex = atoi(value);
+        } else if (strcmp(option, "--position") == 0) {
+            if (sscanf(value, "%f,%f", &simulationConfig.gatewayX, &simulationConfig.gatewayY) != 2) {
+                return false;
+            }
+            positionGiven = true;
+        } else if (strcmp(option, "--sensors") == 0) {
+            simulationConfig.sensorCount = atoi(value);
+        } else if (strcmp(option, "--seed") == 0) {
+            simulationConfig.seed = strtoul(value, nullptr, 10);
+        } else if (strcmp(option, "--http-port") == 0) {
+            simulationConfig.httpPort = atoi(value);
+        } else if (strcmp(option, "--duration") == 0) {
+            simulationConfig.durationMs = strtoul(value, nullptr, 10) * 1000;
+        } else if (strcmp(option, "--notify-interval") == 0) {
+            simulationConfig.notifyIntervalMs = strtoul(value, nullptr, 10);
+        } else if (strcmp(option, "--churn") == 0) {
+            simulationConfig.meanConnectionS = atof(value);
+        } else if (strcmp(option, "--connect-failures") == 0) {
+            simulationConfig.connectFailureRate = atof(value);
+        } else if (strcmp(option, "--malformed") == 0) {
+            simulationConfig.malformedRate = atof(value);
+        } else if (strcmp(option, "--mock-influx") == 0) {
+            simulationConfig.mockInfluxPort = atoi(value);
+        } else if (strcmp(option, "--mock-mqtt") == 0) {
+            simulationConfig.mockMqttPort = atoi(value);
+        } else if (strcmp(option, "--mqtt-drop") == 0) {
+            simulationConfig.mqttDropIntervalMs = strtoul(value, nullptr, 10) * 1000;
+        } else {
+            return false;
+        }
+        i++;
+    }
+    if (simulationConfig.gatewayIndex < 1 || simulationConfig.gatewayIndex > 99 || simulationConfig.sensorCount < 0 ||
+        simulationConfig.notifyIntervalMs == 0) {
+        return false;
+    }
+    if (!positionGiven) {
+        // Gateways 1, 2, 3... stand at the west end, the east end, then in between
+        static const float defaultX[] = {2, 28, 15, 8, 22};
+        simulationConfig.gatewayX = defaultX[(simulationConfig.gatewayIndex - 1) % 5];
+        simulationConfig.gatewayY = 7.5f;
+    }
+    if (simulationConfig.httpPort == 0) {
+        simulationConfig.httpPort = 8080 + simulationConfig.gatewayIndex;
+    }
+    return true;
+}
+
+// Unit tests under test/ bring their own main()
+#ifndef PIO_UNIT_TESTING
+static volatile sig_atomic_t stopRequested = 0;
+
+static void usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [--gateway N] [--position X,Y] [--sensors N] [--seed S] [--http-port P] [--duration SEC]\n"
+        "          [--notify-interval MS] [--churn SEC] [--connect-failures P] [--malformed P] [--mock-influx PORT]\n"
+        "          [--mock-mqtt PORT] [--mqtt-drop SEC]\n"
+        "InfluxDB target can be overridden with SIM_INFLUXDB_URL, SIM_INFLUXDB_ORG, SIM_INFLUXDB_BUCKET and SIM_INFLUXDB_TOKEN,\n"
+        "the MQTT broker with SIM_MQTT_HOST and SIM_MQTT_PORT.\n",
+        program);
+}
+
+static void requestStop(int) {
+    stopRequested = 1;
+}
+
+int main(int argc, char** argv) {
+    if (!parseSimulationArguments(argc, argv)) {
+        usage(argv[0]);
+        return 2;
+    }
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (simulationConfig.mockInfluxPort != 0) {
+        if (!mockInfluxDB.begin(simulationConfig.mockInfluxPort)) {
+            return 1;
+        }
+        char url[32];
+        snprintf(url, sizeof(url), "http://127.0.0.1:%d", simulationConfig.mockInfluxPort);
+        setenv("SIM_INFLUXDB_URL", url, 1);
+    }
+    if (simulationConfig.mockMqttPort != 0) {
+        if (!mockMqttBroker.begin(simulationConfig.mockMqttPort, simulationConfig.mqttDropIntervalMs)) {
+            return 1;
+        }
+        char port[8];
+        snprintf(port, sizeof(port), "%d", simulationConfig.mockMqttPort);
+        setenv("SIM_MQTT_HOST", "127.0.0.1", 1);
+        setenv("SIM_MQTT_PORT", port, 1);
+    }
+
+    setup();
+    if (simulationConfig.mockInfluxPort != 0 || simulationConfig.mockMqttPort != 0) {
+        // Same switch as the dashboard button - a soak run is pointless without publishing
+        cloudPublishingEnabled = true;
+    }
+    while (!stopRequested && (simulationConfig.durationMs == 0 || millis() < simulationConfig.durationMs)) {
+        loop();
+        // The real loop() spins flat out too, but there's no reason to burn a host core on it
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    mockInfluxDB.stop();
+    mockMqttBroker.stop();
+    char gatewayId[16];
+    snprintf(gatewayId, sizeof(gatewayId), "gw-0000%02d", simulationConfig.gatewayIndex);
+    unsigned long sinkPublished;
+    unsigned long sinkDropped;
+    unsigned long sinkQueued;
+    getInfluxDBSinkBacklog(sinkPublished, sinkDropped, sinkQueued);
+    soakStatistics.printReport(gatewayId, millis(), simulationConfig.sensorCount, publishRounds, sinkPublished, sinkDropped, sinkQueued);
+    if (allocationTrackerSteadyStateViolations != nullptr) {
+        unsigned long violations = allocationTrackerSteadyStateViolations();
+        printf("Allocations:   %lu steady-state loop() cycles allocated\n", violations);
+        if (violations > 0) {
+            return 3;
+        }
+    }
+    return 0;
+}
+#endif // PIO_UNIT_TESTING
@@ -0,0 +1,69 @@
+// Arduino.h
+#ifndef HOST_SIMULATOR_ARDUINO_H
+#define HOST_SIMULATOR_ARDUINO_H
+
+/*
+ * Just enough of the Arduino core to run the firmware as a Linux process.
+ * main() lives in Arduino.cpp and drives setup()/loop() like the ESP32 core does.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <math.h>
+
+#include "WString.h"
+
+using std::max;
+using std::min;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+uint32_t esp_random();
+// Moves millis()/micros() forward without waiting - lets unit tests cover timeouts
+void advanceMillis(unsigned long ms);
+
+// The host has plenty of memory, so every build behaves like a board with PSRAM
+inline bool psramFound() { return true; }
+inline void* ps_malloc(size_t size) { return malloc(size); }
+
+// NTP is the host's business - timestamps come straight from the system clock
+inline void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr) {}
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) {}
+
+    size_t print(const String& s) { return fputs(s.c_str(), stdout) >= 0 ? s.length() : 0; }
+    size_t print(const char* s) { return fputs(s, stdout) >= 0 ? strlen(s) : 0; }
+    size_t print(char c) { return fputc(c, stdout) != EOF ? 1 : 0; }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(double value, int digits = 2) { return printf("%.*f", digits, value); }
+
+    template <typename T>
+    size_t println(const T& value) { size_t n = print(value); return n + print('\n'); }
+    size_t println() { return print('\n'); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        int n = vfprintf(stdout, format, args);
+        va_end(args);
+        return n < 0 ? 0 : n;
+    }
+};
+
+extern HardwareSerial Serial;
+
+#endif // HOST_SIMULATOR_ARDUINO_H
@@ -0,0 +1,403 @@
+// ArduinoBLE.cpp
+#include "ArduinoBLE.h"
+
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "FirmwareHeap.h"
+#include "SimulatedRadio.h"
+#include "SimulationConfig.h"
+#include "SoakStatistics.h"
+
+BLELocalDevice BLE;
+SimulatedRadio simulatedRadio;
+
+// Same UUIDs the firmware looks for
+static const char* HUMIDITY_SERVICE = "00001234-B38D-4985-720E-0F993A68EE41";
+static const char* HUMIDITY_CHARACTERISTIC = "00001235-B38D-4985-720E-0F993A68EE41";
+static const char* TEMPERATURE_SERVICE = "00002234-B38D-4985-720E-0F993A68EE41";
+static const char* TEMPERATURE_CHARACTERISTIC = "00002235-B38D-4985-720E-0F993A68EE41";
+static const char* BATTERY_SERVICE = "180F";
+static const char* BATTERY_CHARACTERISTIC = "2A19";
+static const char* CO2_SERVICE = "00007000-B38D-4985-720E-0F993A68EE41";
+static const char* CO2_CHARACTERISTIC = "00007001-B38D-4985-720E-0F993A68EE41";
+
+static const float HOUSE_WIDTH_M = 30;
+static const float HOUSE_DEPTH_M = 15;
+static const float VALUE_PERIOD_MS = 3600000; // one simulated "day" per hour
+
+// --- SimulatedRadio ---
+
+void SimulatedRadio::begin() {
+    std::mt19937 placement(simulationConfig.seed);
+    std::uniform_real_distribution<float> unit(0, 1);
+    noise.seed(simulationConfig.seed * 100 + simulationConfig.gatewayIndex);
+
+    peripherals.clear();
+    peripherals.resize(simulationConfig.sensorCount);
+    pendingEvents.clear();
+    pendingEvents.reserve(2 * simulationConfig.sensorCount + 16);
+    for (int i = 0; i < simulationConfig.sensorCount; i++) {
+        SimulatedPeripheral& peripheral = peripherals[i];
+        snprintf(peripheral.address, sizeof(peripheral.address), "c0:de:00:00:%02x:%02x", (i >> 8) & 0xff, i & 0xff);
+        peripheral.type = static_cast<SimulatedSensorType>(i % SIMULATED_SENSOR_TYPE_COUNT);
+        peripheral.x = unit(placement) * HOUSE_WIDTH_M;
+        peripheral.y = unit(placement) * HOUSE_DEPTH_M;
+        peripheral.phase = unit(placement) * 2 * M_PI;
+        peripheral.nextAdvertisementAt = unit(placement) * ADVERTISING_INTERVAL_MS;
+        addCharacteristics(peripheral);
+    }
+}
+
+void SimulatedRadio::addCharacteristics(SimulatedPeripheral& peripheral) {
+    unsigned long interval = simulationConfig.notifyIntervalMs;
+    peripheral.characteristics.push_back({HUMIDITY_SERVICE, HUMIDITY_CHARACTERISTIC, QUANTITY_HUMIDITY, false, interval});
+    peripheral.characteristics.push_back({TEMPERATURE_SERVICE, TEMPERATURE_CHARACTERISTIC, QUANTITY_TEMPERATURE, false, interval});
+    if (peripheral.type == SIMULATED_SCD4X) {
+        // USB powered - no battery service
+        peripheral.characteristics.push_back({CO2_SERVICE, CO2_CHARACTERISTIC, QUANTITY_CO2, false, interval});
+    } else {
+        peripheral.characteristics.push_back({BATTERY_SERVICE, BATTERY_CHARACTERISTIC, QUANTITY_BATTERY, true, 600000});
+    }
+}
+
+const char* SimulatedRadio::localName(int peripheral) const {
+    switch (peripherals[peripheral].type) {
+        case SIMULATED_HUMIGADGET: return "Smart Humigadget";
+        case SIMULATED_SHT40: return "SHT40 Gadget";
+        default: return "MyCO2";
+    }
+}
+
+int SimulatedRadio::rssi(int peripheral) {
+    // Log-distance path loss: -40 dBm at 1 m, exponent 2.5, a few dB of shadowing noise
+    float dx = peripherals[peripheral].x - simulationConfig.gatewayX;
+    float dy = peripherals[peripheral].y - simulationConfig.gatewayY;
+    float distance = std::max(1.0f, sqrtf(dx * dx + dy * dy));
+    std::normal_distribution<float> shadowing(0, 3);
+    return lroundf(-40 - 25 * log10f(distance) + shadowing(noise));
+}
+
+bool SimulatedRadio::chance(float probability) {
+    return probability > 0 && std::uniform_real_distribution<float>(0, 1)(noise) < probability;
+}
+
+bool SimulatedRadio::acquireLink(SimulatedPeripheral& peripheral) {
+    char path[64];
+    int length = snprintf(path, sizeof(path), "/tmp/smarthouse-sim-%u-", (unsigned)simulationConfig.seed);
+    for (const char* c = peripheral.address; *c != '\0' && length < (int)sizeof(path) - 6; c++) {
+        path[length++] = *c == ':' ? '-' : *c;
+    }
+    strcpy(path + length, ".lock");
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return true; // no shared state to check, behave as if nobody else is around
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return false; // another gateway holds the link
+    }
+    peripheral.linkLock = fd;
+    return true;
+}
+
+void SimulatedRadio::releaseLink(SimulatedPeripheral& peripheral) {
+    if (peripheral.linkLock >= 0) {
+        close(peripheral.linkLock);
+        peripheral.linkLock = -1;
+    }
+}
+
+bool SimulatedRadio::connect(int peripheral) {
+    SimulatedPeripheral& simulated = peripherals[peripheral];
+    if (simulated.connected) {
+        return false;
+    }
+    if (chance(simulationConfig.connectFailureRate)) {
+        soakStatistics.connectionFailures++;
+        return false;
+    }
+    if (!acquireLink(simulated)) {
+        return false;
+    }
+    simulated.connected = true;
+    simulated.dropLinkAt = 0;
+    if (simulationConfig.meanConnectionS > 0) {
+        std::exponential_distribution<float> lifetime(1.0f / (simulationConfig.meanConnectionS * 1000));
+        simulated.dropLinkAt = std::max(1UL, millis() + (unsigned long)lifetime(noise));
+    }
+    soakStatistics.recordConnection(simulated.address);
+    pendingEvents.push_back({BLEConnected, peripheral});
+    return true;
+}
+
+bool SimulatedRadio::disconnect(int peripheral) {
+    SimulatedPeripheral& simulated = peripherals[peripheral];
+    if (!simulated.connected) {
+        return false;
+    }
+    releaseLink(simulated);
+    simulated.connected = false;
+    simulated.reportedThisScan = false;
+    simulated.dropLinkAt = 0;
+    for (SimulatedCharacteristic& characteristic : simulated.characteristics) {
+        characteristic.subscribed = false;
+        characteristic.handler = nullptr;
+    }
+    pendingEvents.push_back({BLEDisconnected, peripheral});
+    return true;
+}
+
+void SimulatedRadio::updateValue(SimulatedPeripheral& peripheral, SimulatedCharacteristic& characteristic, unsigned long now) {
+    float wave = sinf(2 * M_PI * now / VALUE_PERIOD_MS + peripheral.phase);
+    std::uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+    switch (characteristic.quantity) {
+        case QUANTITY_HUMIDITY: {
+            float humidity = 45 + 10 * wave + jitter(noise);
+            memcpy(characteristic.value, &humidity, sizeof(float));
+            characteristic.valueLength = sizeof(float);
+            break;
+        }
+        case QUANTITY_TEMPERATURE: {
+            float temperature = 21 + 3 * wave + jitter(noise);
+            memcpy(characteristic.value, &temperature, sizeof(float));
+            characteristic.valueLength = sizeof(float);
+            break;
+        }
+        case QUANTITY_BATTERY: {
+            characteristic.value[0] = 100 - (now / 3600000) % 100;
+            characteristic.valueLength = 1;
+            break;
+        }
+        case QUANTITY_CO2: {
+            uint16_t co2 = 700 + 300 * wave;
+            memcpy(characteristic.value, &co2, sizeof(uint16_t));
+            characteristic.valueLength = sizeof(uint16_t);
+            break;
+        }
+    }
+}
+
+void SimulatedRadio::notify(int p, int c, unsigned long now) {
+    SimulatedPeripheral& peripheral = peripherals[p];
+    SimulatedCharacteristic& characteristic = peripheral.characteristics[c];
+    updateValue(peripheral, characteristic, now);
+    soakStatistics.notificationsSent++;
+    if (chance(simulationConfig.malformedRate)) {
+        // Cut the payload short - the firmware has to reject it and keep the previous value
+        characteristic.valueLength = std::uniform_int_distribution<int>(0, characteristic.valueLength - 1)(noise);
+        soakStatistics.malformedNotifications++;
+    } else if (characteristic.quantity == (peripheral.type == SIMULATED_SCD4X ? QUANTITY_CO2 : QUANTITY_TEMPERATURE)) {
+        // Only the value the firmware publishes for this sensor type is worth tracking
+        long rounded;
+        if (characteristic.quantity == QUANTITY_CO2) {
+            uint16_t co2;
+            memcpy(&co2, characteristic.value, sizeof(co2));
+            rounded = co2;
+        } else {
+            float temperature;
+            memcpy(&temperature, characteristic.value, sizeof(temperature));
+            rounded = lroundf(temperature * 100);
+        }
+        soakStatistics.recordSample(peripheral.address, rounded, now);
+    }
+    if (characteristic.handler != nullptr) {
+        characteristic.handler(BLEDevice(p), BLECharacteristic(p, c));
+    }
+}
+
+void SimulatedRadio::poll() {
+    unsigned long now = millis();
+
+    // Connection events first, so handlers see the same order a controller would report
+    // Handlers may queue more events, hence the index; clear() keeps the capacity reserved in begin()
+    for (size_t i = 0; i < pendingEvents.size(); i++) {
+        PendingEvent pending = pendingEvents[i];
+        if (deviceHandlers[pending.event] != nullptr) {
+            deviceHandlers[pending.event](BLEDevice(pending.peripheral));
+        }
+    }
+    pendingEvents.clear();
+
+    for (int p = 0; p < (int)peripherals.size(); p++) {
+        SimulatedPeripheral& peripheral = peripherals[p];
+        if (peripheral.connected && peripheral.dropLinkAt != 0 && now >= peripheral.dropLinkAt) {
+            // The sensor walked away (or its battery sagged) - the link drops from its side
+            soakStatistics.churnDisconnects++;
+            disconnect(p);
+        } else if (peripheral.connected) {
+            for (int c = 0; c < (int)peripheral.characteristics.size(); c++) {
+                SimulatedCharacteristic& characteristic = peripheral.characteristics[c];
+                if (!characteristic.subscribed || now < characteristic.nextNotifyAt) {
+                    continue;
+                }
+                characteristic.nextNotifyAt = now + characteristic.notifyIntervalMs;
+                notify(p, c, now);
+                if (!peripheral.connected) {
+                    break; // the handler hung up on us
+                }
+            }
+        } else if (scanning && now >= peripheral.nextAdvertisementAt) {
+            peripheral.nextAdvertisementAt = now + ADVERTISING_INTERVAL_MS;
+            if ((scanWithDuplicates || !peripheral.reportedThisScan) && rssi(p) >= RX_SENSITIVITY_DBM) {
+                peripheral.reportedThisScan = true;
+                if (deviceHandlers[BLEDiscovered] != nullptr) {
+                    deviceHandlers[BLEDiscovered](BLEDevice(p));
+                }
+            }
+        }
+    }
+}
+
+// --- BLELocalDevice ---
+
+int BLELocalDevice::begin() {
+    {
+        SimulatorAllocations simulator; // the synthetic house, not the BLE stack
+        simulatedRadio.begin();
+    }
+    return 1;
+}
+
+void BLELocalDevice::poll(unsigned long timeout) {
+    simulatedRadio.poll();
+}
+
+int BLELocalDevice::scan(bool withDuplicates) {
+    simulatedRadio.scanning = true;
+    simulatedRadio.scanWithDuplicates = withDuplicates;
+    for (SimulatedPeripheral& peripheral : simulatedRadio.peripherals) {
+        peripheral.reportedThisScan = false;
+    }
+    return 1;
+}
+
+void BLELocalDevice::stopScan() {
+    simulatedRadio.scanning = false;
+}
+
+void BLELocalDevice::setEventHandler(BLEDeviceEvent event, BLEDeviceEventHandler handler) {
+    simulatedRadio.deviceHandlers[event] = handler;
+}
+
+// --- BLEDevice ---
+
+String BLEDevice::address() const {
+    return peripheral >= 0 ? String(simulatedRadio.peripherals[peripheral].address) : String("00:00:00:00:00:00");
+}
+
+String BLEDevice::localName() const {
+    return peripheral >= 0 ? String(simulatedRadio.localName(peripheral)) : String();
+}
+
+int BLEDevice::advertisementDataLength() const {
+    return peripheral >= 0 ? 3 + 2 + (int)strlen(simulatedRadio.localName(peripheral)) : 0;
+}
+
+int BLEDevice::advertisementData(uint8_t value[], int length) const {
+    if (peripheral < 0) {
+        return 0;
+    }
+    const char* name = simulatedRadio.localName(peripheral);
+    size_t nameLength = strlen(name);
+    uint8_t data[3 + 2 + 29];
+    data[0] = 2;    // flags: LE general discoverable, BR/EDR not supported
+    data[1] = 0x01;
+    data[2] = 0x06;
+    data[3] = 1 + nameLength;
+    data[4] = 0x09; // complete local name
+    memcpy(data + 5, name, nameLength);
+    int dataLength = min(length, 5 + (int)nameLength);
+    memcpy(value, data, dataLength);
+    return dataLength;
+}
+
+int BLEDevice::rssi() {
+    return peripheral >= 0 ? simulatedRadio.rssi(peripheral) : 127;
+}
+
+bool BLEDevice::connect() {
+    return peripheral >= 0 && simulatedRadio.connect(peripheral);
+}
+
+bool BLEDevice::disconnect() {
+    return peripheral >= 0 && simulatedRadio.disconnect(peripheral);
+}
+
+bool BLEDevice::connected() const {
+    return peripheral >= 0 && simulatedRadio.peripherals[peripheral].connected;
+}
+
+bool BLEDevice::discoverAttributes() {
+    return connected();
+}
+
+BLEService BLEDevice::service(const char* uuid) const {
+    if (peripheral >= 0) {
+        for (const SimulatedCharacteristic& characteristic : simulatedRadio.peripherals[peripheral].characteristics) {
+            if (strcasecmp(characteristic.serviceUuid, uuid) == 0) {
+                return BLEService(peripheral, characteristic.serviceUuid);
+            }
+        }
+    }
+    return BLEService();
+}
+
+// --- BLEService ---
+
+BLECharacteristic BLEService::characteristic(const char* characteristicUuid) const {
+    if (peripheral >= 0) {
+        const std::vector<SimulatedCharacteristic>& characteristics = simulatedRadio.peripherals[peripheral].characteristics;
+        for (int c = 0; c < (int)characteristics.size(); c++) {
+            if (characteristics[c].serviceUuid == uuid && strcasecmp(characteristics[c].uuid, characteristicUuid) == 0) {
+                return BLECharacteristic(peripheral, c);
+            }
+        }
+    }
+    return BLECharacteristic();
+}
+
+// --- BLECharacteristic ---
+
+bool BLECharacteristic::canRead() {
+    return characteristic >= 0 && simulatedRadio.peripherals[peripheral].characteristics[characteristic].readable;
+}
+
+bool BLECharacteristic::canSubscribe() {
+    return characteristic >= 0;
+}
+
+bool BLECharacteristic::read() {
+    if (!canRead()) {
+        return false;
+    }
+    SimulatedPeripheral& simulated = simulatedRadio.peripherals[peripheral];
+    simulatedRadio.updateValue(simulated, simulated.characteristics[characteristic], millis());
+    return true;
+}
+
+bool BLECharacteristic::subscribe() {
+    if (characteristic < 0 || !simulatedRadio.peripherals[peripheral].connected) {
+        return false;
+    }
+    SimulatedCharacteristic& simulated = simulatedRadio.peripherals[peripheral].characteristics[characteristic];
+    simulated.subscribed = true;
+    simulated.nextNotifyAt = millis() + simulated.notifyIntervalMs / 2;
+    return true;
+}
+
+void BLECharacteristic::setEventHandler(int event, BLECharacteristicEventHandler handler) {
+    if (characteristic >= 0 && event == BLEUpdated) {
+        simulatedRadio.peripherals[peripheral].characteristics[characteristic].handler = handler;
+    }
+}
+
+const uint8_t* BLECharacteristic::value() const {
+    return characteristic >= 0 ? simulatedRadio.peripherals[peripheral].characteristics[characteristic].value : nullptr;
+}
+
+int BLECharacteristic::valueLength() const {
+    return characteristic >= 0 ? simulatedRadio.peripherals[peripheral].characteristics[characteristic].valueLength : 0;
+}
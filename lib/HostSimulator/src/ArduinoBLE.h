@@ -0,0 +1,117 @@
+// ArduinoBLE.h
+#ifndef HOST_SIMULATOR_ARDUINO_BLE_H
+#define HOST_SIMULATOR_ARDUINO_BLE_H
+
+#include <Arduino.h>
+
+/*
+ * ArduinoBLE central API backed by SimulatedRadio instead of an HCI controller.
+ * Devices, services and characteristics are small handles into the radio's tables,
+ * so they can be copied around exactly like the real ones.
+ */
+
+enum BLEDeviceEvent {
+    BLEConnected = 0,
+    BLEDisconnected,
+    BLEDiscovered,
+    BLEConnectionParamsUpdate,
+    BLEDeviceLastEvent
+};
+
+enum BLECharacteristicEvent {
+    BLESubscribed = 0,
+    BLEUnsubscribed,
+    BLERead,
+    BLEWritten,
+    BLEUpdated,
+    BLECharacteristicEventLast
+};
+
+class BLEDevice;
+class BLECharacteristic;
+
+typedef void (*BLEDeviceEventHandler)(BLEDevice device);
+typedef void (*BLECharacteristicEventHandler)(BLEDevice device, BLECharacteristic characteristic);
+
+class BLEUuid {
+public:
+    BLEUuid(const char* str) : text(str) {}
+    const char* str() const { return text; }
+
+private:
+    const char* text;
+};
+
+class BLECharacteristic {
+public:
+    BLECharacteristic() {}
+    BLECharacteristic(int peripheral, int characteristic) : peripheral(peripheral), characteristic(characteristic) {}
+
+    bool canRead();
+    bool canSubscribe();
+    bool read();
+    bool subscribe();
+    void setEventHandler(int event, BLECharacteristicEventHandler handler);
+    const uint8_t* value() const;
+    int valueLength() const;
+
+    operator bool() const { return characteristic >= 0; }
+
+private:
+    int peripheral = -1;
+    int characteristic = -1;
+};
+
+class BLEService {
+public:
+    BLEService() {}
+    BLEService(int peripheral, const char* uuid) : peripheral(peripheral), uuid(uuid) {}
+
+    BLECharacteristic characteristic(const char* uuid) const;
+
+    operator bool() const { return peripheral >= 0; }
+
+private:
+    int peripheral = -1;
+    const char* uuid = nullptr;
+};
+
+class BLEDevice {
+public:
+    BLEDevice() {}
+    explicit BLEDevice(int peripheral) : peripheral(peripheral) {}
+
+    String address() const;
+    String localName() const;
+    // Raw advertising data (flags and complete local name) like ArduinoBLE 1.3+, copied into value
+    int advertisementDataLength() const;
+    int advertisementData(uint8_t value[], int length) const;
+    int rssi();
+
+    bool connect();
+    bool disconnect();
+    bool connected() const;
+    bool discoverAttributes();
+    BLEService service(const char* uuid) const;
+
+    bool operator==(const BLEDevice& other) const { return peripheral == other.peripheral; }
+    bool operator!=(const BLEDevice& other) const { return peripheral != other.peripheral; }
+    operator bool() const { return peripheral >= 0; }
+
+private:
+    int peripheral = -1;
+};
+
+class BLELocalDevice {
+public:
+    int begin();
+    void end() {}
+    void poll(unsigned long timeout = 0);
+    int scan(bool withDuplicates = false);
+    void stopScan();
+    void setEventHandler(BLEDeviceEvent event, BLEDeviceEventHandler handler);
+};
+
+extern BLELocalDevice BLE;
+
+#endif // HOST_SIMULATOR_ARDUINO_BLE_H
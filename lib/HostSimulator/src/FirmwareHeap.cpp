@@ -0,0 +1,168 @@
+// FirmwareHeap.cpp
+#include "FirmwareHeap.h"
+
+#include <atomic>
+#include <cstdint>
+
+// setup() and loop() run on the main thread; constant-initialised so reading it inside malloc is safe
+static thread_local bool firmwareThread = false;
+static thread_local bool simulatorAllocation = false;
+static const bool mainThreadMarked = (firmwareThread = true);
+
+SimulatorAllocations::SimulatorAllocations() : previous(simulatorAllocation) {
+    simulatorAllocation = true;
+}
+
+SimulatorAllocations::~SimulatorAllocations() {
+    simulatorAllocation = previous;
+}
+
+#ifdef __GLIBC__
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+}
+
+namespace {
+
+// Open addressing with linear probing; removal shifts the following entries back instead of leaving tombstones
+const size_t TABLE_BITS = 16;
+const size_t TABLE_SIZE = (size_t)1 << TABLE_BITS;
+const size_t TABLE_MASK = TABLE_SIZE - 1;
+const size_t TABLE_LIMIT = TABLE_SIZE / 4 * 3;
+
+struct Block {
+    void* pointer;
+    size_t size;
+};
+
+Block blocks[TABLE_SIZE];
+FirmwareHeapUsage usage;
+std::atomic_flag tableLock = ATOMIC_FLAG_INIT;
+
+class TableGuard {
+public:
+    TableGuard() {
+        while (tableLock.test_and_set(std::memory_order_acquire)) {
+        }
+    }
+    ~TableGuard() { tableLock.clear(std::memory_order_release); }
+};
+
+size_t home(const void* pointer) {
+    return (size_t)((((uintptr_t)pointer >> 4) * 0x9E3779B97F4A7C15ull) >> (64 - TABLE_BITS));
+}
+
+bool counting() {
+    return firmwareThread && !simulatorAllocation;
+}
+
+void insert(void* pointer, size_t size) {
+    TableGuard guard;
+    if (usage.liveBlocks == TABLE_LIMIT) {
+        usage.untrackedBlocks++;
+        return;
+    }
+    size_t slot = home(pointer);
+    while (blocks[slot].pointer != nullptr) {
+        slot = (slot + 1) & TABLE_MASK;
+    }
+    blocks[slot] = {pointer, size};
+    usage.liveBlocks++;
+    usage.liveBytes += size;
+    if (usage.liveBytes > usage.peakBytes) {
+        usage.peakBytes = usage.liveBytes;
+    }
+}
+
+// Size of the block if it was the firmware's, 0 otherwise
+size_t remove(void* pointer) {
+    TableGuard guard;
+    size_t slot = home(pointer);
+    while (blocks[slot].pointer != pointer) {
+        if (blocks[slot].pointer == nullptr) {
+            return 0;
+        }
+        slot = (slot + 1) & TABLE_MASK;
+    }
+    size_t size = blocks[slot].size;
+    usage.liveBlocks--;
+    usage.liveBytes -= size;
+
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & TABLE_MASK; blocks[next].pointer != nullptr; next = (next + 1) & TABLE_MASK) {
+        size_t wanted = home(blocks[next].pointer);
+        // An entry may fill the hole unless its home lies cyclically in (hole, next]
+        bool staysPut = hole <= next ? (hole < wanted && wanted <= next) : (hole < wanted || wanted <= next);
+        if (!staysPut) {
+            blocks[hole] = blocks[next];
+            hole = next;
+        }
+    }
+    blocks[hole].pointer = nullptr;
+    return size;
+}
+
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    void* pointer = __libc_malloc(size);
+    if (pointer != nullptr && counting()) {
+        insert(pointer, size);
+    }
+    return pointer;
+}
+
+void* calloc(size_t count, size_t size) {
+    void* pointer = __libc_calloc(count, size);
+    if (pointer != nullptr && counting()) {
+        insert(pointer, count * size);
+    }
+    return pointer;
+}
+
+void* realloc(void* pointer, size_t size) {
+    size_t previousSize = pointer != nullptr ? remove(pointer) : 0;
+    void* moved = __libc_realloc(pointer, size);
+    if (moved != nullptr && counting()) {
+        insert(moved, size);
+    } else if (moved == nullptr && size != 0 && previousSize != 0) {
+        insert(pointer, previousSize); // failed, the old block is still there
+    }
+    return moved;
+}
+
+void free(void* pointer) {
+    if (pointer != nullptr) {
+        remove(pointer);
+    }
+    __libc_free(pointer);
+}
+
+}
+
+FirmwareHeapUsage firmwareHeapUsage() {
+    TableGuard guard;
+    return usage;
+}
+
+bool firmwareHeapTracked() {
+    return true;
+}
+
+#else
+
+FirmwareHeapUsage firmwareHeapUsage() {
+    return FirmwareHeapUsage();
+}
+
+bool firmwareHeapTracked() {
+    return false;
+}
+
+#endif // __GLIBC__
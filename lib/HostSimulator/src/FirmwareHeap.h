@@ -0,0 +1,37 @@
+// FirmwareHeap.h
+#ifndef HOST_SIMULATOR_FIRMWARE_HEAP_H
+#define HOST_SIMULATOR_FIRMWARE_HEAP_H
+
+#include <cstddef>
+
+/*
+ * Live heap bytes of the firmware, as opposed to the whole simulator process. The simulator
+ * replaces malloc/calloc/realloc/free (glibc only) and remembers every block allocated on the
+ * firmware thread - the one running setup() and loop() - in a fixed table, so a block is
+ * accounted for whichever thread frees it. The shims stand in for libraries that allocate from
+ * the same heap on the ESP32 and count too; the simulator's own bookkeeping opts out with
+ * SimulatorAllocations. Composes with the --wrap allocator of ALLOC_TRACKING builds, whose
+ * __real_malloc ends up here.
+ */
+struct FirmwareHeapUsage {
+    size_t liveBytes;
+    size_t peakBytes;
+    size_t liveBlocks;
+    unsigned long untrackedBlocks; // allocated while the table was full, not in the figures
+};
+
+FirmwareHeapUsage firmwareHeapUsage();
+// false where malloc can't be replaced (not glibc), all figures are 0 then
+bool firmwareHeapTracked();
+
+// Allocations on the firmware thread while one of these is alive belong to the simulator
+class SimulatorAllocations {
+public:
+    SimulatorAllocations();
+    ~SimulatorAllocations();
+
+private:
+    bool previous;
+};
+
+#endif // HOST_SIMULATOR_FIRMWARE_HEAP_H
@@ -0,0 +1,33 @@
+// IPAddress.h
+#ifndef HOST_SIMULATOR_IP_ADDRESS_H
+#define HOST_SIMULATOR_IP_ADDRESS_H
+
+#include <cstdint>
+
+#include "WString.h"
+
+class IPAddress {
+private:
+    uint8_t octets[4];
+
+public:
+    IPAddress() : octets{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+
+    uint8_t operator[](int index) const { return octets[index]; }
+
+    // Network byte order, ready for sockaddr_in
+    uint32_t toNetworkOrder() const {
+        uint32_t address;
+        memcpy(&address, octets, sizeof(address));
+        return address;
+    }
+
+    String toString() const {
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+        return String(text);
+    }
+};
+
+#endif // HOST_SIMULATOR_IP_ADDRESS_H
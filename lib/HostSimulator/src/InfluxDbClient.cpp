@@ -0,0 +1,181 @@
+// InfluxDbClient.cpp
+#include "InfluxDbClient.h"
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "SoakStatistics.h"
+
+static const int HTTP_TIMEOUT_S = 5;
+
+static String escapeKey(const String& text) {
+    String escaped;
+    for (unsigned int i = 0; i < text.length(); i++) {
+        char c = text[i];
+        if (c == ',' || c == '=' || c == ' ') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static String urlEncode(const String& text) {
+    String encoded;
+    for (unsigned int i = 0; i < text.length(); i++) {
+        unsigned char c = text[i];
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            encoded += (char)c;
+        } else {
+            char hex[4];
+            snprintf(hex, sizeof(hex), "%%%02X", c);
+            encoded += hex;
+        }
+    }
+    return encoded;
+}
+
+// Looked up on every use: the client is a global constructed before main() had a chance to set them
+static String overridable(const char* environmentName, const String& value) {
+    const char* overridden = getenv(environmentName);
+    return overridden != nullptr ? String(overridden) : value;
+}
+
+// --- Point ---
+
+void Point::addField(const String& name, float value, int decimalPlaces) {
+    if (!isnan(value)) {
+        fields.push_back(std::make_pair(name, String(value, decimalPlaces)));
+    }
+}
+
+void Point::addField(const String& name, const String& value) {
+    String quoted = "\"";
+    for (unsigned int i = 0; i < value.length(); i++) {
+        if (value[i] == '"' || value[i] == '\\') {
+            quoted += '\\';
+        }
+        quoted += value[i];
+    }
+    quoted += '"';
+    fields.push_back(std::make_pair(name, quoted));
+}
+
+String Point::toLineProtocol() const {
+    String line = escapeKey(measurement);
+    for (const auto& tag : tags) {
+        line += "," + escapeKey(tag.first) + "=" + escapeKey(tag.second);
+    }
+    for (size_t i = 0; i < fields.size(); i++) {
+        line += (i == 0 ? " " : ",") + escapeKey(fields[i].first) + "=" + fields[i].second;
+    }
+    if (!timestamp.isEmpty()) {
+        line += " " + timestamp;
+    }
+    return line;
+}
+
+// --- InfluxDBClient ---
+
+InfluxDBClient::InfluxDBClient(const char* serverUrl, const char* org, const char* bucket, const char* authToken, const char* certInfo)
+    : serverUrl(serverUrl), org(org), bucket(bucket), authToken(authToken) {}
+
+String InfluxDBClient::getServerUrl() const {
+    return overridable("SIM_INFLUXDB_URL", serverUrl);
+}
+
+bool InfluxDBClient::validateConnection() {
+    return request("GET", "/ping", String()) == 204;
+}
+
+bool InfluxDBClient::writePoint(Point& point) {
+    if (!point.hasFields()) {
+        lastErrorMessage = "Point has no fields";
+        return false;
+    }
+    return write(point.toLineProtocol() + "\n");
+}
+
+bool InfluxDBClient::writeRecord(const char* record) {
+    return write(String(record) + "\n");
+}
+
+bool InfluxDBClient::write(const String& body) {
+    String path = "/api/v2/write?org=" + urlEncode(overridable("SIM_INFLUXDB_ORG", org)) +
+        "&bucket=" + urlEncode(overridable("SIM_INFLUXDB_BUCKET", bucket));
+    if (writeOptions._writePrecision == WritePrecision::S) {
+        path += "&precision=s";
+    }
+    soakStatistics.pointsWritten++;
+    bool success = request("POST", path, body) == 204;
+    if (!success) {
+        soakStatistics.writeFailures++;
+    }
+    return success;
+}
+
+int InfluxDBClient::request(const char* method, const String& path, const String& body) {
+    lastStatusCode = 0;
+    // Only plain http://host[:port] - the simulator never talks TLS
+    String url = getServerUrl();
+    if (!url.startsWith("http://")) {
+        lastErrorMessage = "Only http:// URLs are simulated: " + url;
+        return lastStatusCode;
+    }
+    String hostPort = url.substring(7);
+    int slash = hostPort.indexOf('/');
+    if (slash >= 0) {
+        hostPort = hostPort.substring(0, slash);
+    }
+    int colon = hostPort.indexOf(':');
+    String host = colon >= 0 ? hostPort.substring(0, colon) : hostPort;
+    String port = colon >= 0 ? hostPort.substring(colon + 1) : String("80");
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* resolved = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &resolved) != 0) {
+        lastErrorMessage = "Cannot resolve " + host;
+        return lastStatusCode;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    timeval timeout = {HTTP_TIMEOUT_S, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    bool connected = connect(fd, resolved->ai_addr, resolved->ai_addrlen) == 0;
+    freeaddrinfo(resolved);
+    if (!connected) {
+        close(fd);
+        lastErrorMessage = "connection refused";
+        return lastStatusCode;
+    }
+
+    String request = String(method) + " " + path + " HTTP/1.1\r\nHost: " + hostPort +
+        "\r\nAuthorization: Token " + overridable("SIM_INFLUXDB_TOKEN", authToken) +
+        "\r\nContent-Type: text/plain; charset=utf-8\r\nContent-Length: " + String(body.length()) +
+        "\r\nConnection: close\r\n\r\n" + body;
+    if (send(fd, request.c_str(), request.length(), MSG_NOSIGNAL) != (ssize_t)request.length()) {
+        close(fd);
+        lastErrorMessage = "send failed";
+        return lastStatusCode;
+    }
+
+    String response;
+    char buffer[1024];
+    ssize_t received;
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.concat(buffer, received);
+    }
+    close(fd);
+
+    if (sscanf(response.c_str(), "HTTP/%*s %d", &lastStatusCode) != 1) {
+        lastErrorMessage = "malformed response";
+        return lastStatusCode = 0;
+    }
+    int bodyStart = response.indexOf("\r\n\r\n");
+    lastErrorMessage = lastStatusCode / 100 == 2 ? String() : (bodyStart >= 0 ? response.substring(bodyStart + 4) : response);
+    return lastStatusCode;
+}
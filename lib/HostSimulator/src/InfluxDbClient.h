@@ -0,0 +1,77 @@
+// InfluxDbClient.h
+#ifndef HOST_SIMULATOR_INFLUXDB_CLIENT_H
+#define HOST_SIMULATOR_INFLUXDB_CLIENT_H
+
+#include <Arduino.h>
+
+#include <utility>
+#include <vector>
+
+/*
+ * Subset of the ESP8266 Influxdb library: Point building and synchronous writes over plain HTTP.
+ * SIM_INFLUXDB_URL, SIM_INFLUXDB_ORG, SIM_INFLUXDB_BUCKET and SIM_INFLUXDB_TOKEN override secrets.h.
+ */
+
+enum class WritePrecision {
+    NoTime = 0,
+    S,
+    MS,
+    US,
+    NS
+};
+
+class WriteOptions {
+public:
+    WriteOptions& writePrecision(WritePrecision precision) { _writePrecision = precision; return *this; }
+    WritePrecision _writePrecision = WritePrecision::NoTime;
+};
+
+class Point {
+public:
+    explicit Point(const String& measurement) : measurement(measurement) {}
+
+    void addTag(const String& name, const String& value) { tags.push_back(std::make_pair(name, value)); }
+    void addField(const String& name, int value) { fields.push_back(std::make_pair(name, String(value) + "i")); }
+    void addField(const String& name, long value) { fields.push_back(std::make_pair(name, String(value) + "i")); }
+    void addField(const String& name, float value, int decimalPlaces = 2);
+    void addField(const String& name, double value, int decimalPlaces = 2) { addField(name, (float)value, decimalPlaces); }
+    void addField(const String& name, const String& value);
+    void clearFields() { fields.clear(); }
+    void clearTags() { tags.clear(); }
+    void setTime(time_t seconds) { timestamp = String((long)seconds); }
+    bool hasFields() const { return !fields.empty(); }
+    String toLineProtocol() const;
+
+private:
+    String measurement;
+    std::vector<std::pair<String, String>> tags;
+    std::vector<std::pair<String, String>> fields;
+    String timestamp;
+};
+
+class InfluxDBClient {
+public:
+    InfluxDBClient(const char* serverUrl, const char* org, const char* bucket, const char* authToken, const char* certInfo);
+
+    void setWriteOptions(const WriteOptions& options) { writeOptions = options; }
+    bool validateConnection();
+    bool writePoint(Point& point);
+    bool writeRecord(const char* record); // one line protocol record, without the newline
+    String getServerUrl() const;
+    String getLastErrorMessage() const { return lastErrorMessage; }
+    int getLastStatusCode() const { return lastStatusCode; }
+
+private:
+    String serverUrl;
+    String org;
+    String bucket;
+    String authToken;
+    WriteOptions writeOptions;
+    String lastErrorMessage;
+    int lastStatusCode = 0;
+
+    int request(const char* method, const String& path, const String& body);
+    bool write(const String& body);
+};
+
+#endif // HOST_SIMULATOR_INFLUXDB_CLIENT_H
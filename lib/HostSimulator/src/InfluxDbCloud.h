@@ -0,0 +1,8 @@
+// InfluxDbCloud.h
+#ifndef HOST_SIMULATOR_INFLUXDB_CLOUD_H
+#define HOST_SIMULATOR_INFLUXDB_CLOUD_H
+
+// TLS isn't simulated - the certificate is accepted and ignored
+static const char InfluxDbCloud2CACert[] = "";
+
+#endif // HOST_SIMULATOR_INFLUXDB_CLOUD_H
@@ -0,0 +1,206 @@
+// MockInfluxDB.cpp
+#include "MockInfluxDB.h"
+
+#include <Arduino.h>
+
+#include <map>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "SoakStatistics.h"
+
+MockInfluxDB mockInfluxDB;
+
+// Like a bucket with 30 days retention: older points are refused, late ones are fine - queued
+// readings arrive minutes after an outage. Points from the future mean a broken clock.
+static const long RETENTION_S = 30L * 24 * 60 * 60;
+static const long MAX_FUTURE_S = 60;
+static const int CONNECTION_IDLE_TIMEOUT_MS = 5000;
+
+// Splits on separator unless it's escaped with a backslash; escapes are removed
+static std::vector<std::string> splitUnescaped(const std::string& text, char separator) {
+    std::vector<std::string> parts(1);
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\\' && i + 1 < text.size()) {
+            parts.back() += text[++i];
+        } else if (text[i] == separator) {
+            parts.emplace_back();
+        } else {
+            parts.back() += text[i];
+        }
+    }
+    return parts;
+}
+
+static bool inRange(const std::map<std::string, double>& fields, const char* name, double low, double high) {
+    auto field = fields.find(name);
+    return field == fields.end() || (field->second >= low && field->second <= high);
+}
+
+bool MockInfluxDB::begin(int port) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int enable = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 8) != 0) {
+        fprintf(stderr, "MockInfluxDB: cannot listen on port %d\n", port);
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    running = true;
+    worker = std::thread(&MockInfluxDB::serve, this);
+    printf("MockInfluxDB listening on http://127.0.0.1:%d/\n", port);
+    return true;
+}
+
+void MockInfluxDB::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    worker.join();
+    close(listenFd);
+    listenFd = -1;
+}
+
+void MockInfluxDB::serve() {
+    while (running) {
+        pollfd readable = {listenFd, POLLIN, 0};
+        if (poll(&readable, 1, 100) <= 0) {
+            continue;
+        }
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd >= 0) {
+            handleConnection(fd);
+            close(fd);
+        }
+    }
+}
+
+void MockInfluxDB::handleConnection(int fd) {
+    std::string buffer;
+    char chunk[4096];
+    // Keep-alive aware: serve requests until the client closes or goes idle
+    while (running) {
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            pollfd readable = {fd, POLLIN, 0};
+            ssize_t received = poll(&readable, 1, CONNECTION_IDLE_TIMEOUT_MS) > 0 ? recv(fd, chunk, sizeof(chunk), 0) : 0;
+            if (received <= 0) {
+                return;
+            }
+            buffer.append(chunk, received);
+        }
+        std::string header = buffer.substr(0, headerEnd);
+        size_t contentLength = 0;
+        size_t lengthHeader = header.find("Content-Length:");
+        if (lengthHeader != std::string::npos) {
+            contentLength = strtoul(header.c_str() + lengthHeader + 15, nullptr, 10);
+        }
+        while (buffer.size() < headerEnd + 4 + contentLength) {
+            pollfd readable = {fd, POLLIN, 0};
+            ssize_t received = poll(&readable, 1, CONNECTION_IDLE_TIMEOUT_MS) > 0 ? recv(fd, chunk, sizeof(chunk), 0) : 0;
+            if (received <= 0) {
+                return;
+            }
+            buffer.append(chunk, received);
+        }
+        std::string body = buffer.substr(headerEnd + 4, contentLength);
+        buffer.erase(0, headerEnd + 4 + contentLength);
+
+        int status = 404;
+        if (header.rfind("GET /ping ", 0) == 0) {
+            status = 204;
+        } else if (header.rfind("POST /api/v2/write?", 0) == 0) {
+            status = 204;
+            unsigned long receivedAtMs = millis();
+            size_t start = 0;
+            while (start < body.size()) {
+                size_t end = body.find('\n', start);
+                if (end == std::string::npos) {
+                    end = body.size();
+                }
+                std::string line = body.substr(start, end - start);
+                if (!line.empty() && !acceptLine(line, receivedAtMs)) {
+                    fprintf(stderr, "MockInfluxDB: rejected %s\n", line.c_str());
+                    status = 400;
+                }
+                start = end + 1;
+            }
+        }
+        const char* response = status == 204 ? "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n"
+            : status == 400 ? "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n"
+            : "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        send(fd, response, strlen(response), MSG_NOSIGNAL);
+        if (header.find("Connection: close") != std::string::npos) {
+            return;
+        }
+    }
+}
+
+bool MockInfluxDB::acceptLine(const std::string& line, unsigned long receivedAtMs) {
+    // Spaces inside tag values are escaped, so three unescaped parts: series, fields, timestamp
+    std::vector<std::string> parts;
+    std::string current;
+    for (size_t i = 0; i < line.size(); i++) {
+        if (line[i] == '\\' && i + 1 < line.size()) {
+            current += line[i];
+            current += line[++i];
+        } else if (line[i] == ' ') {
+            parts.push_back(current);
+            current.clear();
+        } else {
+            current += line[i];
+        }
+    }
+    parts.push_back(current);
+
+    bool valid = parts.size() == 3;
+    std::map<std::string, std::string> tags;
+    std::map<std::string, double> fields;
+    if (valid) {
+        std::vector<std::string> series = splitUnescaped(parts[0], ',');
+        valid = series[0] == "sensor_measurement";
+        for (size_t i = 1; i < series.size(); i++) {
+            size_t equals = series[i].find('=');
+            valid = valid && equals != std::string::npos;
+            if (equals != std::string::npos) {
+                tags[series[i].substr(0, equals)] = series[i].substr(equals + 1);
+            }
+        }
+        for (const std::string& field : splitUnescaped(parts[1], ',')) {
+            size_t equals = field.find('=');
+            char* end = nullptr;
+            double value = equals != std::string::npos ? strtod(field.c_str() + equals + 1, &end) : 0;
+            valid = valid && end != nullptr && (*end == '\0' || (*end == 'i' && end[1] == '\0'));
+            if (equals != std::string::npos) {
+                fields[field.substr(0, equals)] = value;
+            }
+        }
+        long age = (long)time(nullptr) - strtol(parts[2].c_str(), nullptr, 10);
+        valid = valid && age <= RETENTION_S && age >= -MAX_FUTURE_S;
+    }
+    valid = valid && tags.count("deviceId") && tags.count("location") && tags.count("gateway") && fields.count("rssi");
+    valid = valid && inRange(fields, "temperature", -40, 125) && inRange(fields, "humidity", 0, 100) &&
+        inRange(fields, "battery", -1, 100) && inRange(fields, "co2", 0, 40000) && inRange(fields, "rssi", -127, 20);
+    if (!valid) {
+        soakStatistics.pointsRejected++;
+        return false;
+    }
+
+    soakStatistics.pointsAccepted++;
+    const char* address = tags["deviceId"].c_str();
+    if (fields.count("co2")) {
+        soakStatistics.recordDelivery(address, lround(fields["co2"]), receivedAtMs);
+    } else if (fields.count("temperature")) {
+        soakStatistics.recordDelivery(address, lround(fields["temperature"] * 100), receivedAtMs);
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+// MockInfluxDB.h
+#ifndef HOST_SIMULATOR_MOCK_INFLUXDB_H
+#define HOST_SIMULATOR_MOCK_INFLUXDB_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+/*
+ * Stand-in for InfluxDB's /ping and /api/v2/write running on its own thread.
+ * Every line is checked the way the Grafana dashboard relies on it - measurement,
+ * deviceId/location/gateway tags, plausible field values, a timestamp within retention -
+ * and counted in soakStatistics. A request with any bad line gets 400, like the real server.
+ */
+class MockInfluxDB {
+public:
+    bool begin(int port);
+    void stop();
+
+private:
+    int listenFd = -1;
+    std::atomic<bool> running{false};
+    std::thread worker;
+
+    void serve();
+    void handleConnection(int fd);
+    bool acceptLine(const std::string& line, unsigned long receivedAtMs);
+};
+
+extern MockInfluxDB mockInfluxDB;
+
+#endif // HOST_SIMULATOR_MOCK_INFLUXDB_H
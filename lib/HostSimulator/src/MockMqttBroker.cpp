@@ -0,0 +1,218 @@
+// MockMqttBroker.cpp
+#include "MockMqttBroker.h"
+
+#include <Arduino.h>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "SoakStatistics.h"
+
+MockMqttBroker mockMqttBroker;
+
+// Readings may arrive long after they were taken - they wait in the gateway's queue through an
+// outage - but never from the future and, per topic, never older than the one before: the queue is
+// FIFO, so going back in time means a batch was resent or reordered. A resent duplicate of the
+// newest reading can't be told from a retry and passes.
+static const long MAX_AGE_S = 30L * 24 * 60 * 60;
+static const long MAX_FUTURE_S = 60;
+static const int KEEP_ALIVE_GRACE_MS = 90000; // 1.5 x the gateway's keep-alive
+
+// Reads exactly length bytes unless the client goes away or stays silent too long
+static bool receiveExactly(int fd, uint8_t* buffer, size_t length) {
+    size_t received = 0;
+    while (received < length) {
+        pollfd readable = {fd, POLLIN, 0};
+        if (poll(&readable, 1, KEEP_ALIVE_GRACE_MS) <= 0) {
+            return false;
+        }
+        ssize_t chunk = recv(fd, buffer + received, length - received, 0);
+        if (chunk <= 0) {
+            return false;
+        }
+        received += chunk;
+    }
+    return true;
+}
+
+static bool inRange(const std::string& field, double low, double high, bool required) {
+    if (field.empty()) {
+        return !required;
+    }
+    char* end = nullptr;
+    double value = strtod(field.c_str(), &end);
+    return *end == '\0' && value >= low && value <= high;
+}
+
+bool MockMqttBroker::begin(int port, unsigned long dropIntervalMs) {
+    this->dropIntervalMs = dropIntervalMs;
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int enable = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 4) != 0) {
+        fprintf(stderr, "MockMqttBroker: cannot listen on port %d\n", port);
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    running = true;
+    worker = std::thread(&MockMqttBroker::serve, this);
+    printf("MockMqttBroker listening on mqtt://127.0.0.1:%d\n", port);
+    return true;
+}
+
+void MockMqttBroker::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    worker.join();
+    close(listenFd);
+    listenFd = -1;
+}
+
+void MockMqttBroker::serve() {
+    while (running) {
+        pollfd readable = {listenFd, POLLIN, 0};
+        if (poll(&readable, 1, 100) <= 0) {
+            continue;
+        }
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd >= 0) {
+            handleConnection(fd);
+            close(fd);
+        }
+    }
+}
+
+void MockMqttBroker::handleConnection(int fd) {
+    unsigned long connectedAt = millis();
+    bool connected = false;
+    while (running) {
+        if (dropIntervalMs > 0 && millis() - connectedAt >= dropIntervalMs) {
+            soakStatistics.mqttDrops++;
+            return; // hang up without a word, like a broker restart
+        }
+        pollfd readable = {fd, POLLIN, 0};
+        int ready = poll(&readable, 1, 100);
+        if (ready == 0) {
+            continue;
+        }
+        uint8_t type;
+        if (ready < 0 || !receiveExactly(fd, &type, 1)) {
+            return;
+        }
+        size_t remaining = 0;
+        for (int shift = 0; ; shift += 7) {
+            uint8_t digit;
+            if (shift > 21 || !receiveExactly(fd, &digit, 1)) {
+                return;
+            }
+            remaining |= (size_t)(digit & 0x7F) << shift;
+            if ((digit & 0x80) == 0) {
+                break;
+            }
+        }
+        std::vector<uint8_t> body(remaining);
+        if (remaining > 0 && !receiveExactly(fd, body.data(), remaining)) {
+            return;
+        }
+
+        switch (type & 0xF0) {
+        case 0x10: { // CONNECT
+            bool valid = remaining >= 12 && body[0] == 0 && body[1] == 4 && memcmp(&body[2], "MQTT", 4) == 0 && body[6] == 4;
+            const uint8_t connack[] = {0x20, 0x02, 0x00, (uint8_t)(valid ? 0x00 : 0x01)};
+            send(fd, connack, sizeof(connack), MSG_NOSIGNAL);
+            if (!valid) {
+                return;
+            }
+            connected = true;
+            soakStatistics.mqttConnections++;
+            break;
+        }
+        case 0x30: { // PUBLISH
+            size_t topicLength = remaining >= 2 ? (body[0] << 8 | body[1]) : 0;
+            if (!connected || (type & 0x06) != 0 || remaining < 2 + topicLength) {
+                soakStatistics.mqttRejected++; // not connected, QoS > 0 or truncated
+                return;
+            }
+            std::string topic(body.begin() + 2, body.begin() + 2 + topicLength);
+            std::string payload(body.begin() + 2 + topicLength, body.end());
+            if (topic.size() > 7 && topic.compare(topic.size() - 7, 7, "/status") == 0) {
+                break; // online / offline
+            }
+            if (acceptPublish(topic, payload)) {
+                soakStatistics.mqttAccepted++;
+            } else {
+                fprintf(stderr, "MockMqttBroker: rejected %s %s\n", topic.c_str(), payload.c_str());
+                soakStatistics.mqttRejected++;
+            }
+            break;
+        }
+        case 0xC0: { // PINGREQ
+            const uint8_t pingresp[] = {0xD0, 0x00};
+            send(fd, pingresp, sizeof(pingresp), MSG_NOSIGNAL);
+            break;
+        }
+        case 0xE0: // DISCONNECT
+            return;
+        default:
+            fprintf(stderr, "MockMqttBroker: unexpected packet type 0x%02x\n", type);
+            return;
+        }
+    }
+}
+
+bool MockMqttBroker::acceptPublish(const std::string& topic, const std::string& payload) {
+    // smarthouse/<gateway>/<aa:bb:cc:dd:ee:ff>
+    size_t gatewayEnd = topic.find('/', 11);
+    if (topic.rfind("smarthouse/", 0) != 0 || gatewayEnd == std::string::npos || topic.size() - gatewayEnd - 1 != 17) {
+        return false;
+    }
+
+    long timestamp;
+    if (payload.find(',') == std::string::npos && payload.size() == 12) {
+        const uint8_t* record = reinterpret_cast<const uint8_t*>(payload.data());
+        timestamp = record[0] | record[1] << 8 | record[2] << 16 | (long)record[3] << 24;
+        int16_t temperature = record[4] | record[5] << 8;
+        uint16_t humidity = record[6] | record[7] << 8;
+        int8_t rssi = record[11];
+        if ((temperature != INT16_MIN && (temperature < -4000 || temperature > 12500)) ||
+            (humidity != 0xFFFF && humidity > 10000) || rssi > 20) {
+            return false;
+        }
+    } else {
+        // timestamp,temperature,humidity,co2,battery,rssi
+        std::vector<std::string> fields(1);
+        for (char c : payload) {
+            if (c == ',') {
+                fields.emplace_back();
+            } else {
+                fields.back() += c;
+            }
+        }
+        if (fields.size() != 6 || !inRange(fields[0], 0, 4e9, true) || !inRange(fields[1], -40, 125, false) ||
+            !inRange(fields[2], 0, 100, false) || !inRange(fields[3], 0, 40000, false) ||
+            !inRange(fields[4], 0, 100, false) || !inRange(fields[5], -127, 20, true)) {
+            return false;
+        }
+        timestamp = strtol(fields[0].c_str(), nullptr, 10);
+    }
+    long age = (long)time(nullptr) - timestamp;
+    if (age > MAX_AGE_S || age < -MAX_FUTURE_S) {
+        return false;
+    }
+    auto previous = lastTimestamps.find(topic);
+    if (previous != lastTimestamps.end() && timestamp < previous->second) {
+        return false;
+    }
+    lastTimestamps[topic] = timestamp;
+    return true;
+}
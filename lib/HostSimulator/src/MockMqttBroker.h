@@ -0,0 +1,37 @@
+// MockMqttBroker.h
+#ifndef HOST_SIMULATOR_MOCK_MQTT_BROKER_H
+#define HOST_SIMULATOR_MOCK_MQTT_BROKER_H
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+
+/*
+ * Just enough of an MQTT 3.1.1 broker to test the gateway's MQTT sink, on its own thread:
+ * CONNECT/CONNACK, QoS 0 PUBLISH, PINGREQ/PINGRESP and DISCONNECT, one client at a time.
+ * Every sensor publish is checked - topic smarthouse/<gateway>/<address>, CSV or 12 byte binary
+ * payload with plausible values, a timestamp that isn't from the future and never goes back on a
+ * topic - and counted in soakStatistics.
+ * --mqtt-drop SEC makes it hang up on the client that often to exercise reconnects.
+ */
+class MockMqttBroker {
+public:
+    bool begin(int port, unsigned long dropIntervalMs);
+    void stop();
+
+private:
+    int listenFd = -1;
+    unsigned long dropIntervalMs = 0;
+    std::atomic<bool> running{false};
+    std::thread worker;
+    std::map<std::string, long> lastTimestamps; // newest accepted reading per topic, broker thread only
+
+    void serve();
+    void handleConnection(int fd);
+    bool acceptPublish(const std::string& topic, const std::string& payload);
+};
+
+extern MockMqttBroker mockMqttBroker;
+
+#endif // HOST_SIMULATOR_MOCK_MQTT_BROKER_H
@@ -0,0 +1,29 @@
+// SimulatedMqttSettings.h
+#ifndef HOST_SIMULATOR_SIMULATED_MQTT_SETTINGS_H
+#define HOST_SIMULATOR_SIMULATED_MQTT_SETTINGS_H
+
+#include <stdlib.h>
+
+/*
+ * Broker of the simulator's MQTT sink: 127.0.0.1:1883 unless SIM_MQTT_HOST / SIM_MQTT_PORT say
+ * otherwise. Included after secrets.h on host builds and replaces whatever broker a real
+ * src/secrets.h names, so --mock-mqtt and SIM_MQTT_HOST always win over the production broker.
+ */
+#undef MQTT_HOST
+#undef MQTT_PORT
+#undef MQTT_USERNAME
+#undef MQTT_PASSWORD
+
+// Looked up on every connect so --mock-mqtt can redirect it after startup
+inline const char* simulatedMqttHost() {
+    const char* host = getenv("SIM_MQTT_HOST");
+    return host != nullptr ? host : "127.0.0.1";
+}
+inline int simulatedMqttPort() {
+    const char* port = getenv("SIM_MQTT_PORT");
+    return port != nullptr ? atoi(port) : 1883;
+}
+#define MQTT_HOST simulatedMqttHost()
+#define MQTT_PORT simulatedMqttPort()
+
+#endif // HOST_SIMULATOR_SIMULATED_MQTT_SETTINGS_H
@@ -0,0 +1,33 @@
+// SimulatedMulticast.h
+#ifndef HOST_SIMULATOR_SIMULATED_MULTICAST_H
+#define HOST_SIMULATOR_SIMULATED_MULTICAST_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+/*
+ * Socket options that let several simulated gateways share one multicast group: they all bind the
+ * same port and hear each other over loopback. Set SIM_MULTICAST_IF to a local interface address
+ * to reach gateways on other machines instead. Called on host builds between socket() and bind();
+ * returns the interface to join the group on.
+ */
+inline in_addr configureSimulatedMulticast(int fd) {
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+    unsigned char loop = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    in_addr interfaceAddress = {};
+    interfaceAddress.s_addr = htonl(INADDR_ANY);
+    const char* multicastInterface = getenv("SIM_MULTICAST_IF");
+    if (multicastInterface != nullptr) {
+        inet_pton(AF_INET, multicastInterface, &interfaceAddress);
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interfaceAddress, sizeof(interfaceAddress));
+    }
+    return interfaceAddress;
+}
+
+#endif // HOST_SIMULATOR_SIMULATED_MULTICAST_H
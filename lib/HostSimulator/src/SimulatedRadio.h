@@ -0,0 +1,100 @@
+// SimulatedRadio.h
+#ifndef HOST_SIMULATOR_SIMULATED_RADIO_H
+#define HOST_SIMULATOR_SIMULATED_RADIO_H
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+
+#include <random>
+#include <vector>
+
+/*
+ * A synthetic house full of Sensirion gadgets. Sensor placement depends only on --seed,
+ * so every simulated gateway sees the same house; RSSI follows a log-distance path loss
+ * model from the gateway's --position plus per-gateway noise. Like the real gadgets, a sensor
+ * takes one central at a time: gateways with the same seed share a lock file per sensor in /tmp,
+ * and connecting fails while another gateway process holds it.
+ *
+ * For soak runs the radio can also misbehave: links that drop after a random time (--churn),
+ * connection attempts that fail (--connect-failures) and truncated notification payloads
+ * (--malformed). Every valid sample is reported to soakStatistics for latency tracking.
+ */
+
+enum SimulatedSensorType {
+    SIMULATED_HUMIGADGET = 0,
+    SIMULATED_SHT40,
+    SIMULATED_SCD4X,
+    SIMULATED_SENSOR_TYPE_COUNT
+};
+
+enum SimulatedQuantity {
+    QUANTITY_HUMIDITY = 0,
+    QUANTITY_TEMPERATURE,
+    QUANTITY_BATTERY,
+    QUANTITY_CO2
+};
+
+struct SimulatedCharacteristic {
+    const char* serviceUuid;
+    const char* uuid;
+    SimulatedQuantity quantity;
+    bool readable;
+    unsigned long notifyIntervalMs;
+    unsigned long nextNotifyAt = 0;
+    bool subscribed = false;
+    BLECharacteristicEventHandler handler = nullptr;
+    uint8_t value[4] = {0};
+    uint8_t valueLength = 0;
+};
+
+struct SimulatedPeripheral {
+    char address[18];
+    SimulatedSensorType type;
+    float x;
+    float y;
+    float phase; // keeps sensors from reporting identical curves
+    bool connected = false;
+    bool reportedThisScan = false;
+    unsigned long nextAdvertisementAt = 0;
+    unsigned long dropLinkAt = 0; // 0 = link stays up
+    int linkLock = -1;            // flock()ed lock file while this gateway holds the link
+    std::vector<SimulatedCharacteristic> characteristics;
+};
+
+class SimulatedRadio {
+public:
+    static const int RX_SENSITIVITY_DBM = -95;
+    static const unsigned long ADVERTISING_INTERVAL_MS = 1000;
+
+    std::vector<SimulatedPeripheral> peripherals;
+    BLEDeviceEventHandler deviceHandlers[BLEDeviceLastEvent] = {nullptr};
+    bool scanning = false;
+    bool scanWithDuplicates = false;
+
+    void begin();
+    void poll();
+    int rssi(int peripheral);
+    const char* localName(int peripheral) const;
+    bool connect(int peripheral);
+    bool disconnect(int peripheral);
+    void updateValue(SimulatedPeripheral& peripheral, SimulatedCharacteristic& characteristic, unsigned long now);
+    void notify(int peripheral, int characteristic, unsigned long now);
+
+private:
+    struct PendingEvent {
+        BLEDeviceEvent event;
+        int peripheral;
+    };
+
+    std::vector<PendingEvent> pendingEvents;
+    std::mt19937 noise;
+
+    void addCharacteristics(SimulatedPeripheral& peripheral);
+    bool acquireLink(SimulatedPeripheral& peripheral);
+    void releaseLink(SimulatedPeripheral& peripheral);
+    bool chance(float probability);
+};
+
+extern SimulatedRadio simulatedRadio;
+
+#endif // HOST_SIMULATOR_SIMULATED_RADIO_H
@@ -0,0 +1,34 @@
+// SimulationConfig.h
+#ifndef HOST_SIMULATOR_SIMULATION_CONFIG_H
+#define HOST_SIMULATOR_SIMULATION_CONFIG_H
+
+#include <cstdint>
+
+/*
+ * Command line of the simulated gateway. Several gateways started with the same --seed
+ * see the same synthetic house; --gateway picks this one's MAC address and where it stands.
+ */
+struct SimulationConfig {
+    int gatewayIndex = 1;          // --gateway N     MAC 02:00:00:00:00:NN, id gw-0000NN
+    float gatewayX = 0;            // --position X,Y  metres, defaults to spreading gateways along the house
+    float gatewayY = 0;
+    int sensorCount = 6;           // --sensors N
+    uint32_t seed = 1;             // --seed S
+    int httpPort = 0;              // --http-port P   defaults to 8080 + gateway index
+    unsigned long durationMs = 0;  // --duration SEC  0 runs until interrupted
+
+    // Soak knobs
+    unsigned long notifyIntervalMs = 5000; // --notify-interval MS  humidity/temperature/CO2 notifications
+    float meanConnectionS = 0;     // --churn SEC          mean time before a sensor drops the link, 0 = never
+    float connectFailureRate = 0;  // --connect-failures P probability a connection attempt fails
+    float malformedRate = 0;       // --malformed P        probability a notification payload is truncated
+    int mockInfluxPort = 0;        // --mock-influx PORT   serve /api/v2/write in-process, publish to it from the start
+    int mockMqttPort = 0;          // --mock-mqtt PORT     run a minimal MQTT broker in-process, publish to it from the start
+    unsigned long mqttDropIntervalMs = 0; // --mqtt-drop SEC  the mock broker hangs up on the gateway this often
+};
+
+extern SimulationConfig simulationConfig;
+
+bool parseSimulationArguments(int argc, char** argv);
+
+#endif // HOST_SIMULATOR_SIMULATION_CONFIG_H
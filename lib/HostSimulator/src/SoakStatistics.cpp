@@ -0,0 +1,115 @@
+// SoakStatistics.cpp
+#include "SoakStatistics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sys/resource.h>
+
+#include "FirmwareHeap.h"
+
+SoakStatistics soakStatistics;
+
+void SoakStatistics::recordSample(const char* address, long roundedValue, unsigned long generatedAtMs) {
+    SimulatorAllocations simulator;
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = samples.find(address);
+    if (found == samples.end()) {
+        found = samples.emplace(address, SensorSamples()).first;
+        found->second.ring.reserve(SAMPLE_HISTORY);
+    }
+    SensorSamples& sensor = found->second;
+    if (sensor.ring.size() < SAMPLE_HISTORY) {
+        sensor.ring.push_back({roundedValue, generatedAtMs});
+    } else {
+        sensor.ring[sensor.next] = {roundedValue, generatedAtMs};
+    }
+    sensor.next = (sensor.next + 1) % SAMPLE_HISTORY;
+}
+
+void SoakStatistics::recordDelivery(const char* address, long roundedValue, unsigned long receivedAtMs) {
+    SimulatorAllocations simulator;
+    std::lock_guard<std::mutex> guard(lock);
+    delivered[address]++;
+    auto sensor = samples.find(address);
+    if (sensor == samples.end()) {
+        pointsUnmatched++;
+        return;
+    }
+    // Newest sample with that value - the firmware always publishes the latest one it got
+    const Sample* match = nullptr;
+    for (const Sample& sample : sensor->second.ring) {
+        if (sample.value == roundedValue && sample.generatedAtMs <= receivedAtMs &&
+            (match == nullptr || sample.generatedAtMs > match->generatedAtMs)) {
+            match = &sample;
+        }
+    }
+    if (match == nullptr) {
+        pointsUnmatched++;
+        return;
+    }
+    latenciesMs.push_back(receivedAtMs - match->generatedAtMs);
+}
+
+void SoakStatistics::recordConnection(const char* address) {
+    SimulatorAllocations simulator;
+    std::lock_guard<std::mutex> guard(lock);
+    connected[address] = true;
+    connectionsOpened++;
+    // Made room for here rather than on the first notification: connecting is allowed to allocate,
+    // a notification arriving later isn't, and ALLOC_TRACKING builds can't tell this map from the firmware
+    auto found = samples.find(address);
+    if (found == samples.end()) {
+        samples.emplace(address, SensorSamples()).first->second.ring.reserve(SAMPLE_HISTORY);
+    }
+}
+
+static double percentile(const std::vector<unsigned long>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, (size_t)(fraction * (sorted.size() - 1) + 0.5));
+    return sorted[index] / 1000.0;
+}
+
+void SoakStatistics::printReport(const char* gatewayId, unsigned long elapsedMs, int sensorCount,
+    unsigned long publishRounds, unsigned long sinkPublished, unsigned long sinkDropped, unsigned long sinkQueued) {
+    SimulatorAllocations simulator;
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<unsigned long> sorted(latenciesMs);
+    std::sort(sorted.begin(), sorted.end());
+    unsigned long written = pointsWritten;
+    unsigned long accepted = pointsAccepted;
+    // Every reading the gateway queued for InfluxDB is owed - sensors another gateway owns or that
+    // were out of reach never get queued here. Readings still queued at the end are neither
+    // delivered nor lost yet; a retried point counts once.
+    unsigned long settled = sinkPublished - std::min(sinkPublished, sinkQueued);
+    unsigned long lost = settled - std::min(settled, accepted);
+    double dropRate = settled == 0 ? 0 : 100.0 * lost / settled;
+    FirmwareHeapUsage heap = firmwareHeapUsage();
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("\n=== Soak report: %s, %.0f s ===\n", gatewayId, elapsedMs / 1000.0);
+    printf("Sensors:       %d simulated, %zu connected at least once, %zu published at least once\n",
+        sensorCount, connected.size(), delivered.size());
+    printf("Connections:   %lu opened, %lu failed, %lu dropped by churn\n",
+        connectionsOpened.load(), connectionFailures.load(), churnDisconnects.load());
+    printf("Notifications: %lu sent, %lu malformed\n", notificationsSent.load(), malformedNotifications.load());
+    printf("Points:        %lu written, %lu write failures, %lu accepted, %lu rejected, %lu unmatched\n",
+        written, writeFailures.load(), accepted, pointsRejected.load(), pointsUnmatched.load());
+    if (mqttConnections > 0) {
+        printf("MQTT:          %lu connections, %lu dropped by the broker, %lu messages accepted, %lu rejected\n",
+            mqttConnections.load(), mqttDrops.load(), mqttAccepted.load(), mqttRejected.load());
+    }
+    printf("Readings:      %lu queued for InfluxDB in %lu rounds (%.1f sensors per round), %lu still queued, %lu dropped or refused\n",
+        sinkPublished, publishRounds, publishRounds == 0 ? 0.0 : (double)sinkPublished / publishRounds, sinkQueued, sinkDropped);
+    printf("Drop rate:     %.2f %% (%lu of %lu queued points never accepted)\n", dropRate, lost, settled);
+    printf("Latency:       p50 %.1f s, p95 %.1f s, p99 %.1f s, max %.1f s (%zu samples)\n",
+        percentile(sorted, 0.50), percentile(sorted, 0.95), percentile(sorted, 0.99),
+        sorted.empty() ? 0.0 : sorted.back() / 1000.0, sorted.size());
+    if (firmwareHeapTracked()) {
+        printf("Firmware heap: %.1f KB peak, %.1f KB in %zu blocks at the end%s\n", heap.peakBytes / 1024.0,
+            heap.liveBytes / 1024.0, heap.liveBlocks, heap.untrackedBlocks > 0 ? " (table overflowed, figures low)" : "");
+    }
+    printf("Process:       %ld KB max RSS, simulator and mock servers included\n", usage.ru_maxrss);
+}
@@ -0,0 +1,70 @@
+// SoakStatistics.h
+#ifndef HOST_SIMULATOR_SOAK_STATISTICS_H
+#define HOST_SIMULATOR_SOAK_STATISTICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * What happened to every sample between the synthetic radio and the (mock) database.
+ * The radio remembers recent values per sensor; when a point arrives the mock InfluxDB
+ * looks its value up to tell how old the published sample was. Shared between the
+ * firmware thread and the mock server thread, hence the atomics and the mutex.
+ */
+class SoakStatistics {
+public:
+    std::atomic<unsigned long> notificationsSent{0};
+    std::atomic<unsigned long> malformedNotifications{0};
+    std::atomic<unsigned long> connectionsOpened{0};
+    std::atomic<unsigned long> connectionFailures{0};
+    std::atomic<unsigned long> churnDisconnects{0};
+    std::atomic<unsigned long> pointsWritten{0};
+    std::atomic<unsigned long> writeFailures{0};
+    std::atomic<unsigned long> pointsAccepted{0};
+    std::atomic<unsigned long> pointsRejected{0};
+    std::atomic<unsigned long> pointsUnmatched{0};
+    std::atomic<unsigned long> mqttConnections{0};
+    std::atomic<unsigned long> mqttAccepted{0};
+    std::atomic<unsigned long> mqttRejected{0};
+    std::atomic<unsigned long> mqttDrops{0};
+
+    // Radio side: a valid sample with this (rounded) value left the sensor at generatedAtMs
+    void recordSample(const char* address, long roundedValue, unsigned long generatedAtMs);
+    // Database side: a point carrying this value for this sensor arrived at receivedAtMs
+    void recordDelivery(const char* address, long roundedValue, unsigned long receivedAtMs);
+    void recordConnection(const char* address);
+
+    // publishRounds: publish ticks with publishing on. sinkPublished / sinkDropped / sinkQueued: readings
+    // queued for the InfluxDB sink / pushed out of its full queue or refused / still in it
+    void printReport(const char* gatewayId, unsigned long elapsedMs, int sensorCount,
+        unsigned long publishRounds, unsigned long sinkPublished, unsigned long sinkDropped, unsigned long sinkQueued);
+
+private:
+    static const size_t SAMPLE_HISTORY = 256;
+
+    struct Sample {
+        long value;
+        unsigned long generatedAtMs;
+    };
+
+    struct SensorSamples {
+        std::vector<Sample> ring;
+        size_t next = 0;
+    };
+
+    std::mutex lock;
+    // Transparent comparators so lookups by const char* don't build a temporary std::string -
+    // recordSample runs on every notification and must not disturb allocation tracking
+    std::map<std::string, SensorSamples, std::less<>> samples;
+    std::map<std::string, unsigned long, std::less<>> delivered;
+    std::map<std::string, bool, std::less<>> connected;
+    std::vector<unsigned long> latenciesMs;
+};
+
+extern SoakStatistics soakStatistics;
+
+#endif // HOST_SIMULATOR_SOAK_STATISTICS_H
@@ -0,0 +1,128 @@
+// WString.h
+#ifndef HOST_SIMULATOR_WSTRING_H
+#define HOST_SIMULATOR_WSTRING_H
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/*
+ * Arduino String backed by std::string - only the subset the firmware (and ArduinoJson) uses.
+ */
+class String {
+private:
+    std::string buffer;
+
+    template <typename T>
+    static std::string format(const char* fmt, T value) {
+        char text[40];
+        snprintf(text, sizeof(text), fmt, value);
+        return text;
+    }
+
+    static std::string inBase(unsigned long value, unsigned char base) {
+        if (base == 10) {
+            return format("%lu", value);
+        }
+        std::string digits;
+        do {
+            digits.insert(digits.begin(), "0123456789abcdefghijklmnopqrstuvwxyz"[value % base]);
+            value /= base;
+        } while (value != 0);
+        return digits;
+    }
+
+public:
+    String() {}
+    String(const char* text) : buffer(text != nullptr ? text : "") {}
+    String(const std::string& text) : buffer(text) {}
+    explicit String(char c) : buffer(1, c) {}
+    explicit String(int value, unsigned char base = 10) : buffer(value < 0 && base == 10 ? format("%d", value) : inBase((unsigned int)value, base)) {}
+    explicit String(unsigned int value, unsigned char base = 10) : buffer(inBase(value, base)) {}
+    explicit String(long value, unsigned char base = 10) : buffer(value < 0 && base == 10 ? format("%ld", value) : inBase((unsigned long)value, base)) {}
+    explicit String(unsigned long value, unsigned char base = 10) : buffer(inBase(value, base)) {}
+    explicit String(float value, unsigned int decimalPlaces = 2) : String((double)value, decimalPlaces) {}
+    explicit String(double value, unsigned int decimalPlaces = 2) {
+        char text[64];
+        snprintf(text, sizeof(text), "%.*f", (int)decimalPlaces, value);
+        buffer = text;
+    }
+
+    const char* c_str() const { return buffer.c_str(); }
+    unsigned int length() const { return buffer.length(); }
+    bool isEmpty() const { return buffer.empty(); }
+    bool reserve(unsigned int size) { buffer.reserve(size); return true; }
+
+    char charAt(unsigned int index) const { return index < buffer.length() ? buffer[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return buffer[index]; }
+
+    bool concat(const String& other) { buffer += other.buffer; return true; }
+    bool concat(const char* text) { if (text == nullptr) return false; buffer += text; return true; }
+    bool concat(const char* text, unsigned int length) { if (text == nullptr) return false; buffer.append(text, length); return true; }
+    bool concat(char c) { buffer += c; return true; }
+    bool concat(int value) { return concat(String(value)); }
+    bool concat(unsigned int value) { return concat(String(value)); }
+    bool concat(long value) { return concat(String(value)); }
+    bool concat(unsigned long value) { return concat(String(value)); }
+    bool concat(float value) { return concat(String(value)); }
+    bool concat(double value) { return concat(String(value)); }
+
+    template <typename T>
+    String& operator+=(const T& value) { concat(value); return *this; }
+
+    bool equals(const String& other) const { return buffer == other.buffer; }
+    bool equals(const char* text) const { return buffer == (text != nullptr ? text : ""); }
+    bool operator==(const String& other) const { return equals(other); }
+    bool operator==(const char* text) const { return equals(text); }
+    bool operator!=(const String& other) const { return !equals(other); }
+    bool operator!=(const char* text) const { return !equals(text); }
+    bool operator<(const String& other) const { return buffer < other.buffer; }
+    bool startsWith(const String& prefix) const { return buffer.compare(0, prefix.buffer.length(), prefix.buffer) == 0; }
+
+    int indexOf(char c, unsigned int from = 0) const {
+        size_t position = buffer.find(c, from);
+        return position == std::string::npos ? -1 : (int)position;
+    }
+    int indexOf(const String& text, unsigned int from = 0) const {
+        size_t position = buffer.find(text.buffer, from);
+        return position == std::string::npos ? -1 : (int)position;
+    }
+    String substring(unsigned int from) const { return from < buffer.length() ? String(buffer.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) {
+            std::swap(from, to);
+        }
+        return from < buffer.length() ? String(buffer.substr(from, to - from)) : String();
+    }
+
+    void replace(const String& find, const String& replacement) {
+        if (find.buffer.empty()) {
+            return;
+        }
+        for (size_t position = buffer.find(find.buffer); position != std::string::npos;
+             position = buffer.find(find.buffer, position + replacement.buffer.length())) {
+            buffer.replace(position, find.buffer.length(), replacement.buffer);
+        }
+    }
+    void toLowerCase() { for (char& c : buffer) c = (char)tolower((unsigned char)c); }
+    void toUpperCase() { for (char& c : buffer) c = (char)toupper((unsigned char)c); }
+    void trim() {
+        size_t first = buffer.find_first_not_of(" \t\r\n");
+        size_t last = buffer.find_last_not_of(" \t\r\n");
+        buffer = first == std::string::npos ? std::string() : buffer.substr(first, last - first + 1);
+    }
+    long toInt() const { return strtol(buffer.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(buffer.c_str(), nullptr); }
+};
+
+inline String operator+(const String& lhs, const String& rhs) { String result(lhs); result += rhs; return result; }
+inline String operator+(const String& lhs, const char* rhs) { String result(lhs); result += rhs; return result; }
+inline String operator+(const char* lhs, const String& rhs) { String result(lhs); result += rhs; return result; }
+inline String operator+(const String& lhs, char rhs) { String result(lhs); result += rhs; return result; }
+inline bool operator==(const char* lhs, const String& rhs) { return rhs == lhs; }
+inline bool operator!=(const char* lhs, const String& rhs) { return rhs != lhs; }
+
+#endif // HOST_SIMULATOR_WSTRING_H
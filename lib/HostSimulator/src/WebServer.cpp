@@ -0,0 +1,257 @@
+// WebServer.cpp
+#include "WebServer.h"
+
+#include <fcntl.h>
+#include <strings.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "SimulationConfig.h"
+
+static const size_t MAX_REQUEST_SIZE = 8192;
+static const int REQUEST_TIMEOUT_MS = 2000;
+
+static String urlDecode(const char* text, size_t length) {
+    String decoded;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '+') {
+            decoded += ' ';
+        } else if (text[i] == '%' && i + 2 < length) {
+            char hex[3] = {text[i + 1], text[i + 2], 0};
+            decoded += (char)strtol(hex, nullptr, 16);
+            i += 2;
+        } else {
+            decoded += text[i];
+        }
+    }
+    return decoded;
+}
+
+static const char* statusText(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        default: return "Error";
+    }
+}
+
+WebServer::~WebServer() {
+    if (listenFd >= 0) {
+        close(listenFd);
+    }
+}
+
+void WebServer::begin() {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int enable = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(simulationConfig.httpPort);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 8) != 0) {
+        fprintf(stderr, "WebServer: cannot listen on port %d\n", simulationConfig.httpPort);
+        close(listenFd);
+        listenFd = -1;
+        return;
+    }
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+    printf("WebServer listening on http://localhost:%d/\n", simulationConfig.httpPort);
+}
+
+void WebServer::handleClient() {
+    if (listenFd < 0) {
+        return;
+    }
+    clientFd = accept(listenFd, nullptr, nullptr);
+    if (clientFd < 0) {
+        return;
+    }
+    if (readRequest()) {
+        bool handled = false;
+        for (const auto& handler : handlers) {
+            if (handler.first == requestUri) {
+                handler.second();
+                handled = true;
+                break;
+            }
+        }
+        if (!handled && notFoundHandler) {
+            notFoundHandler();
+        } else if (!handled) {
+            send(404, "text/plain", "Not found: " + requestUri);
+        }
+    }
+    close(clientFd);
+    clientFd = -1;
+    contentLength = 0;
+    chunked = false;
+    responseHeaders = "";
+}
+
+bool WebServer::readRequest() {
+    char request[MAX_REQUEST_SIZE + 1];
+    size_t length = 0;
+    while (length < MAX_REQUEST_SIZE) {
+        pollfd readable = {clientFd, POLLIN, 0};
+        if (poll(&readable, 1, REQUEST_TIMEOUT_MS) <= 0) {
+            return false;
+        }
+        ssize_t received = recv(clientFd, request + length, MAX_REQUEST_SIZE - length, 0);
+        if (received <= 0) {
+            return false;
+        }
+        length += received;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") != nullptr) {
+            break;
+        }
+    }
+    // "GET /path?query HTTP/1.1" - the body (if any) is not needed by any handler
+    const char* target = strchr(request, ' ');
+    const char* targetEnd = target != nullptr ? strchr(target + 1, ' ') : nullptr;
+    if (targetEnd == nullptr) {
+        return false;
+    }
+    target++;
+    const char* query = static_cast<const char*>(memchr(target, '?', targetEnd - target));
+    requestUri = urlDecode(target, (query != nullptr ? query : targetEnd) - target);
+    arguments.clear();
+    if (query != nullptr) {
+        parseQuery(String(std::string(query + 1, targetEnd)));
+    }
+
+    // "Name: value" lines up to the blank line, names compared case-insensitively
+    requestHeaders.clear();
+    const char* line = strstr(request, "\r\n");
+    while (line != nullptr && strncmp(line, "\r\n\r\n", 4) != 0) {
+        line += 2;
+        const char* lineEnd = strstr(line, "\r\n");
+        const char* colon = static_cast<const char*>(memchr(line, ':', lineEnd - line));
+        if (colon != nullptr) {
+            for (const auto& name : collectedHeaders) {
+                if ((size_t)(colon - line) == name.length() && strncasecmp(line, name.c_str(), name.length()) == 0) {
+                    const char* value = colon + 1;
+                    while (*value == ' ') {
+                        value++;
+                    }
+                    requestHeaders.push_back(std::make_pair(name, String(std::string(value, lineEnd))));
+                }
+            }
+        }
+        line = lineEnd;
+    }
+    return true;
+}
+
+void WebServer::collectHeaders(const char* headerKeys[], const size_t headerKeysCount) {
+    collectedHeaders.assign(headerKeys, headerKeys + headerKeysCount);
+}
+
+bool WebServer::hasHeader(const String& name) const {
+    for (const auto& header : requestHeaders) {
+        if (strcasecmp(header.first.c_str(), name.c_str()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+String WebServer::header(const String& name) const {
+    for (const auto& header : requestHeaders) {
+        if (strcasecmp(header.first.c_str(), name.c_str()) == 0) {
+            return header.second;
+        }
+    }
+    return String();
+}
+
+void WebServer::sendHeader(const String& name, const String& value, bool first) {
+    String line = name + ": " + value + "\r\n";
+    responseHeaders = first ? line + responseHeaders : responseHeaders + line;
+}
+
+void WebServer::parseQuery(const String& query) {
+    const char* pair = query.c_str();
+    while (*pair != '\0') {
+        const char* pairEnd = strchr(pair, '&');
+        if (pairEnd == nullptr) {
+            pairEnd = pair + strlen(pair);
+        }
+        const char* equals = static_cast<const char*>(memchr(pair, '=', pairEnd - pair));
+        const char* nameEnd = equals != nullptr ? equals : pairEnd;
+        String value = equals != nullptr ? urlDecode(equals + 1, pairEnd - equals - 1) : String();
+        arguments.push_back(std::make_pair(urlDecode(pair, nameEnd - pair), value));
+        pair = *pairEnd == '&' ? pairEnd + 1 : pairEnd;
+    }
+}
+
+bool WebServer::hasArg(const String& name) const {
+    for (const auto& argument : arguments) {
+        if (argument.first == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+String WebServer::arg(const String& name) const {
+    for (const auto& argument : arguments) {
+        if (argument.first == name) {
+            return argument.second;
+        }
+    }
+    return String();
+}
+
+void WebServer::send(int code, const char* contentType, const String& content) {
+    if (clientFd < 0) {
+        return;
+    }
+    char header[256];
+    int headerLength = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\n", code, statusText(code));
+    if (contentType != nullptr) {
+        headerLength += snprintf(header + headerLength, sizeof(header) - headerLength, "Content-Type: %s\r\n", contentType);
+    }
+    if (contentLength == CONTENT_LENGTH_UNKNOWN) {
+        chunked = true;
+        headerLength += snprintf(header + headerLength, sizeof(header) - headerLength, "Transfer-Encoding: chunked\r\n");
+    } else {
+        headerLength += snprintf(header + headerLength, sizeof(header) - headerLength, "Content-Length: %u\r\n", content.length());
+    }
+    headerLength += snprintf(header + headerLength, sizeof(header) - headerLength, "Connection: close\r\n");
+    ::send(clientFd, header, headerLength, MSG_NOSIGNAL);
+    ::send(clientFd, responseHeaders.c_str(), responseHeaders.length(), MSG_NOSIGNAL);
+    ::send(clientFd, "\r\n", 2, MSG_NOSIGNAL);
+    if (chunked) {
+        if (content.length() > 0) {
+            sendContent(content);
+        }
+        return;
+    }
+    ::send(clientFd, content.c_str(), content.length(), MSG_NOSIGNAL);
+}
+
+void WebServer::sendContent(const char* content, size_t length) {
+    if (clientFd < 0) {
+        return;
+    }
+    if (!chunked) {
+        ::send(clientFd, content, length, MSG_NOSIGNAL);
+        return;
+    }
+    // A zero-length chunk ends the response, the same as on the ESP32
+    char chunkSize[16];
+    int chunkSizeLength = snprintf(chunkSize, sizeof(chunkSize), "%zx\r\n", length);
+    ::send(clientFd, chunkSize, chunkSizeLength, MSG_NOSIGNAL);
+    ::send(clientFd, content, length, MSG_NOSIGNAL);
+    ::send(clientFd, "\r\n", 2, MSG_NOSIGNAL);
+    if (length == 0) {
+        chunked = false;
+    }
+}
@@ -0,0 +1,64 @@
+// WebServer.h
+#ifndef HOST_SIMULATOR_WEB_SERVER_H
+#define HOST_SIMULATOR_WEB_SERVER_H
+
+#include <Arduino.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+/*
+ * ESP32 WebServer on a plain POSIX socket: one request per handleClient(), Connection: close.
+ * Like the real one, setContentLength(CONTENT_LENGTH_UNKNOWN) switches send() to chunked
+ * transfer encoding, sendContent() writes chunks and sendContent("") finishes the response.
+ * Only request headers named in collectHeaders() are kept; sendHeader() adds response headers.
+ * The port given by the firmware is ignored in favour of --http-port so gateways can share a host.
+ */
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+class WebServer {
+public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    explicit WebServer(int port = 80) {}
+    ~WebServer();
+
+    void on(const String& uri, THandlerFunction handler) { handlers.push_back(std::make_pair(uri, handler)); }
+    void onNotFound(THandlerFunction handler) { notFoundHandler = handler; }
+    void begin();
+    void handleClient();
+
+    bool hasArg(const String& name) const;
+    String arg(const String& name) const;
+    String uri() const { return requestUri; }
+
+    void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+    bool hasHeader(const String& name) const;
+    String header(const String& name) const;
+    void sendHeader(const String& name, const String& value, bool first = false);
+
+    void send(int code, const char* contentType = nullptr, const String& content = String());
+    void send(int code, const String& contentType, const String& content) { send(code, contentType.c_str(), content); }
+    void setContentLength(size_t length) { contentLength = length; }
+    void sendContent(const char* content, size_t length);
+    void sendContent(const String& content) { sendContent(content.c_str(), content.length()); }
+
+private:
+    int listenFd = -1;
+    int clientFd = -1;
+    String requestUri;
+    size_t contentLength = 0;
+    bool chunked = false;
+    std::vector<std::pair<String, String>> arguments;
+    std::vector<String> collectedHeaders;
+    std::vector<std::pair<String, String>> requestHeaders;
+    String responseHeaders;
+    std::vector<std::pair<String, THandlerFunction>> handlers;
+    THandlerFunction notFoundHandler;
+
+    bool readRequest();
+    void parseQuery(const String& query);
+};
+
+#endif // HOST_SIMULATOR_WEB_SERVER_H
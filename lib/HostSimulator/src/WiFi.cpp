@@ -0,0 +1,39 @@
+// WiFi.cpp
+#include "WiFi.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "SimulationConfig.h"
+
+WiFiClass WiFi;
+
+IPAddress WiFiClass::localIP() {
+    // Whatever address the host would use to reach the outside world
+    IPAddress address(127, 0, 0, 1);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return address;
+    }
+    sockaddr_in remote = {};
+    remote.sin_family = AF_INET;
+    remote.sin_port = htons(53);
+    inet_pton(AF_INET, "192.0.2.1", &remote.sin_addr);
+    sockaddr_in local = {};
+    socklen_t length = sizeof(local);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) == 0 &&
+        getsockname(fd, reinterpret_cast<sockaddr*>(&local), &length) == 0) {
+        const uint8_t* octets = reinterpret_cast<const uint8_t*>(&local.sin_addr.s_addr);
+        address = IPAddress(octets[0], octets[1], octets[2], octets[3]);
+    }
+    close(fd);
+    return address;
+}
+
+String WiFiClass::macAddress() {
+    char mac[18];
+    snprintf(mac, sizeof(mac), "02:00:00:00:00:%02d", simulationConfig.gatewayIndex);
+    return String(mac);
+}
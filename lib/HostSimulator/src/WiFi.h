@@ -0,0 +1,30 @@
+// WiFi.h
+#ifndef HOST_SIMULATOR_WIFI_H
+#define HOST_SIMULATOR_WIFI_H
+
+#include <Arduino.h>
+
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiUdp.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_CONNECTED = 3,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+/*
+ * The host is always "connected"; the MAC address follows --gateway so simulated gateways get distinct ids.
+ */
+class WiFiClass {
+public:
+    void begin(const char* ssid, const char* password) {}
+    wl_status_t status() { return WL_CONNECTED; }
+    IPAddress localIP();
+    String macAddress();
+};
+
+extern WiFiClass WiFi;
+
+#endif // HOST_SIMULATOR_WIFI_H
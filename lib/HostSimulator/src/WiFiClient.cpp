@@ -0,0 +1,91 @@
+// WiFiClient.cpp
+#include "WiFiClient.h"
+
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static const int CLIENT_TIMEOUT_S = 3;
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    stop();
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* resolved = nullptr;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &resolved) != 0) {
+        return 0;
+    }
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    timeval timeout = {CLIENT_TIMEOUT_S, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    bool connected = ::connect(fd, resolved->ai_addr, resolved->ai_addrlen) == 0;
+    freeaddrinfo(resolved);
+    if (!connected) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t sent = send(fd, buffer, size, MSG_NOSIGNAL);
+    return sent < 0 ? 0 : sent;
+}
+
+int WiFiClient::available() {
+    int pending = 0;
+    if (fd < 0 || ioctl(fd, FIONREAD, &pending) != 0) {
+        return 0;
+    }
+    return pending;
+}
+
+int WiFiClient::read() {
+    uint8_t value;
+    return read(&value, 1) == 1 ? value : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t received = recv(fd, buffer, size, MSG_DONTWAIT);
+    return received < 0 ? -1 : received;
+}
+
+uint8_t WiFiClient::connected() {
+    if (fd < 0) {
+        return 0;
+    }
+    // The peer closed if the socket is readable but has nothing to read
+    char probe;
+    ssize_t peeked = recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (peeked == 0 || (peeked < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiClient::stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+int WiFiClient::setNoDelay(bool noDelay) {
+    int enable = noDelay ? 1 : 0;
+    return fd >= 0 ? setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) : -1;
+}
@@ -0,0 +1,31 @@
+// WiFiClient.h
+#ifndef HOST_SIMULATOR_WIFI_CLIENT_H
+#define HOST_SIMULATOR_WIFI_CLIENT_H
+
+#include <Arduino.h>
+
+/*
+ * ESP32 WiFiClient on a blocking POSIX TCP socket. Writes time out after a few seconds,
+ * reads only ever return what is already buffered, like on the ESP32.
+ */
+class WiFiClient {
+public:
+    WiFiClient() {}
+    ~WiFiClient() { stop(); }
+    WiFiClient(const WiFiClient&) = delete;
+    WiFiClient& operator=(const WiFiClient&) = delete;
+
+    int connect(const char* host, uint16_t port);
+    size_t write(const uint8_t* buffer, size_t size);
+    int available();
+    int read();
+    int read(uint8_t* buffer, size_t size);
+    uint8_t connected();
+    void stop();
+    int setNoDelay(bool noDelay);
+
+private:
+    int fd = -1;
+};
+
+#endif // HOST_SIMULATOR_WIFI_CLIENT_H
@@ -0,0 +1,126 @@
+// WiFiUdp.cpp
+#include "WiFiUdp.h"
+
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+uint8_t WiFiUDP::beginMulticast(IPAddress multicast, uint16_t port) {
+    stop();
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    // Every simulated gateway binds the same port
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0) {
+        stop();
+        return 0;
+    }
+
+    in_addr interfaceAddress = {};
+    interfaceAddress.s_addr = htonl(INADDR_ANY);
+    const char* multicastInterface = getenv("SIM_MULTICAST_IF");
+    if (multicastInterface != nullptr) {
+        inet_pton(AF_INET, multicastInterface, &interfaceAddress);
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interfaceAddress, sizeof(interfaceAddress));
+    }
+    ip_mreq membership = {};
+    membership.imr_multiaddr.s_addr = multicast.toNetworkOrder();
+    membership.imr_interface = interfaceAddress;
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+        stop();
+        return 0;
+    }
+    unsigned char loop = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    multicastGroup = multicast;
+    multicastPort = port;
+    return 1;
+}
+
+void WiFiUDP::stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+int WiFiUDP::beginMulticastPacket() {
+    txLength = 0;
+    return fd >= 0 ? 1 : 0;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size) {
+    size_t room = BUFFER_SIZE - txLength;
+    size_t count = size < room ? size : room;
+    memcpy(txBuffer + txLength, buffer, count);
+    txLength += count;
+    return count;
+}
+
+int WiFiUDP::endPacket() {
+    if (fd < 0) {
+        return 0;
+    }
+    sockaddr_in destination = {};
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(multicastPort);
+    destination.sin_addr.s_addr = multicastGroup.toNetworkOrder();
+    ssize_t sent = sendto(fd, txBuffer, txLength, 0, reinterpret_cast<sockaddr*>(&destination), sizeof(destination));
+    txLength = 0;
+    return sent >= 0 ? 1 : 0;
+}
+
+int WiFiUDP::parsePacket() {
+    delete[] rxBuffer;
+    rxBuffer = nullptr;
+    rxLength = 0;
+    rxPosition = 0;
+    if (fd < 0) {
+        return 0;
+    }
+    uint8_t* scratch = static_cast<uint8_t*>(malloc(RX_SCRATCH_SIZE));
+    if (scratch == nullptr) {
+        return 0;
+    }
+    sockaddr_in source = {};
+    socklen_t sourceLength = sizeof(source);
+    ssize_t received = recvfrom(fd, scratch, RX_SCRATCH_SIZE, 0, reinterpret_cast<sockaddr*>(&source), &sourceLength);
+    if (received > 0) {
+        const uint8_t* octets = reinterpret_cast<const uint8_t*>(&source.sin_addr.s_addr);
+        remoteAddress = IPAddress(octets[0], octets[1], octets[2], octets[3]);
+        remotePortNumber = ntohs(source.sin_port);
+        rxBuffer = new uint8_t[received];
+        memcpy(rxBuffer, scratch, received);
+        rxLength = received;
+    }
+    free(scratch);
+    return received > 0 ? received : 0;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t length) {
+    size_t count = rxLength - rxPosition;
+    if (count > length) {
+        count = length;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    memcpy(buffer, rxBuffer + rxPosition, count);
+    rxPosition += count;
+    return count;
+}
@@ -0,0 +1,55 @@
+// WiFiUdp.h
+#ifndef HOST_SIMULATOR_WIFI_UDP_H
+#define HOST_SIMULATOR_WIFI_UDP_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "IPAddress.h"
+
+/*
+ * ESP32 WiFiUDP on top of a POSIX socket. Multicast is looped back so several
+ * simulated gateways on one machine hear each other; set SIM_MULTICAST_IF to a
+ * local interface address to reach gateways on other machines instead.
+ * Receiving allocates like the ESP32 core does: parsePacket() mallocs a 1460 byte scratch
+ * buffer on every call, waiting datagram or not, and news a buffer for each packet it returns.
+ */
+class WiFiUDP {
+private:
+    static const size_t BUFFER_SIZE = 1500;
+    static const size_t RX_SCRATCH_SIZE = 1460;
+
+    int fd = -1;
+    IPAddress multicastGroup;
+    uint16_t multicastPort = 0;
+    uint8_t txBuffer[BUFFER_SIZE];
+    size_t txLength = 0;
+    uint8_t* rxBuffer = nullptr;
+    size_t rxLength = 0;
+    size_t rxPosition = 0;
+    IPAddress remoteAddress;
+    uint16_t remotePortNumber = 0;
+
+public:
+    ~WiFiUDP() {
+        stop();
+        delete[] rxBuffer;
+    }
+
+    uint8_t beginMulticast(IPAddress multicast, uint16_t port);
+    void stop();
+
+    int beginMulticastPacket();
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t write(uint8_t byte) { return write(&byte, 1); }
+    int endPacket();
+
+    int parsePacket();
+    int available() { return rxLength - rxPosition; }
+    int read(uint8_t* buffer, size_t length);
+    int read(char* buffer, size_t length) { return read(reinterpret_cast<uint8_t*>(buffer), length); }
+    IPAddress remoteIP() { return remoteAddress; }
+    uint16_t remotePort() { return remotePortNumber; }
+};
+
+#endif // HOST_SIMULATOR_WIFI_UDP_H
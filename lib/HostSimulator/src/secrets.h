@@ -0,0 +1,23 @@
+#ifndef SECRETS_H
+#define SECRETS_H
+
+// Used by the host simulator when src/secrets.h doesn't exist. Points at the docker-compose InfluxDB;
+// override with SIM_INFLUXDB_URL, SIM_INFLUXDB_ORG, SIM_INFLUXDB_BUCKET and SIM_INFLUXDB_TOKEN.
+// MQTT goes to a broker on 127.0.0.1:1883 unless SIM_MQTT_HOST / SIM_MQTT_PORT say otherwise.
+
+#include <stdlib.h>
+
+// WiFi credentials
+const char* WIFI_SSID = "simulated";
+const char* WIFI_PASSWORD = "simulated";
+
+// InfluxDB
+const char* INFLUXDB_URL = "http://127.0.0.1:8086";
+const char* INFLUXDB_TOKEN = "simulated-token";
+const char* INFLUXDB_ORG = "smarthouse";
+const char* INFLUXDB_BUCKET = "sensors";
+
+// MQTT
+#include "SimulatedMqttSettings.h"
+
+#endif // SECRETS_H
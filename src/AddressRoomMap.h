@@ -9,8 +9,8 @@
  * So this tightly-coupled-with-app implementation is sufficient.
 */
 struct AddressRoomPair {
-    String peripheralAddress;
-    String room;
+    const char* peripheralAddress;
+    const char* room;
 };
 
 static const AddressRoomPair roomSimpleMap[] = {
@@ -21,9 +21,10 @@ static const AddressRoomPair roomSimpleMap[] = {
 
 static const int roomSimpleMapSize = sizeof(roomSimpleMap) / sizeof(AddressRoomPair);
 
-inline String getRoomNameByAddress(const String& address) {
+// Plain strings, the publisher looks rooms up for every reading
+inline const char* getRoomNameByAddress(const char* address) {
     for (int i = 0; i < roomSimpleMapSize; i++) {
-        if (roomSimpleMap[i].peripheralAddress == address) {
+        if (strcmp(roomSimpleMap[i].peripheralAddress, address) == 0) {
             return roomSimpleMap[i].room;
         }
     }
@@ -0,0 +1,342 @@
+// AllocationTracker.h
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <Arduino.h>
+
+#include "ExtremelySimpleLogger.h"
+
+#if ALLOC_TRACKING && !defined(ESP_PLATFORM)
+#include <dlfcn.h>
+#endif
+
+/*
+ * Heap allocation accounting for hunting fragmentation. Build with -DALLOC_TRACKING=1 and
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free (see the *_alloc environments
+ * in platformio.ini), otherwise every macro below compiles to nothing.
+ *
+ * Every allocation made on the loop() task is counted against its caller - the return address
+ * taken in the malloc wrappers (or in operator new on the host), so resolve it with addr2line -
+ * and against the subsystem of the innermost ALLOC_SCOPE(subsystem), whose file:line is kept
+ * alongside. Allocations made by other tasks (WiFi, BLE controller, simulator threads) are only
+ * totalled.
+ *
+ * ALLOC_LOOP_CYCLE() at the top of loop() enforces the steady-state guarantee: once
+ * ALLOC_WARMUP_MS has passed, a loop() cycle must not allocate at all. The only exception are
+ * allocations inside an ALLOC_ALLOWED() scope, which wraps just the library call that serves an
+ * HTTP request, makes an outgoing request or (re)connects a sensor or sink - those libraries
+ * allocate internally. Code that may or may not serve a request, like WebServer::handleClient(),
+ * goes into ALLOC_ALLOWED_IF_SERVED(): its allocations are forgiven only if an ALLOC_ALLOWED()
+ * ran inside it. Anything else the same cycle allocates still counts. Every offending cycle is
+ * counted and its caller logged; test/test_alloc_steady_state fails if the count isn't zero.
+ */
+
+enum AllocationSubsystem {
+  ALLOC_LOOP = 0,      // loop() itself and anything outside a scope
+  ALLOC_BLE_CALLBACK,  // characteristic notifications - the hot path
+  ALLOC_BLE_SCAN,      // advertisements, connects and disconnects
+  ALLOC_COORDINATOR,   // gateway announcements and ownership checks
+  ALLOC_HTTP_HANDLER,
+  ALLOC_PUBLISHER,
+  ALLOC_SUBSYSTEM_COUNT
+};
+
+#if ALLOC_TRACKING
+
+#ifndef ALLOC_WARMUP_MS
+#define ALLOC_WARMUP_MS 120000
+#endif
+
+#define ALLOC_STRINGIFY_(x) #x
+#define ALLOC_STRINGIFY(x) ALLOC_STRINGIFY_(x)
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+void __real_free(void* pointer);
+}
+
+static const char* const ALLOCATION_SUBSYSTEM_NAMES[ALLOC_SUBSYSTEM_COUNT] = {
+  "loop", "bleCallback", "bleScan", "coordinator", "httpHandler", "publisher"
+};
+static const int MAX_ALLOCATION_SITES = 64;
+
+struct AllocationCounter {
+  unsigned long count;
+  unsigned long bytes;
+
+  AllocationCounter() : count(0), bytes(0) {}
+};
+
+struct AllocationSite {
+  const void* caller;  // nullptr = free entry
+  const char* scope;   // file:line of the ALLOC_SCOPE it last allocated in, nullptr = none
+  AllocationSubsystem subsystem;
+  AllocationCounter counter;
+
+  AllocationSite() : caller(nullptr), scope(nullptr), subsystem(ALLOC_LOOP) {}
+};
+
+// The instruction that called the allocator, as addr2line expects it
+static inline const void* allocationCaller(void* returnAddress) {
+#ifdef __XTENSA__
+  // The windowed ABI keeps the window increment in the top two bits, and the call is 3 bytes back
+  return reinterpret_cast<const void*>((((uintptr_t)returnAddress & 0x3fffffff) | 0x40000000) - 3);
+#else
+  return returnAddress;
+#endif
+}
+
+// Set on the task that runs setup() and loop(); everything else counts as "other tasks"
+static thread_local bool allocationTrackingLoopTask = false;
+
+class AllocationTracker {
+public:
+    AllocationCounter subsystems[ALLOC_SUBSYSTEM_COUNT];
+    AllocationCounter otherTasks;
+    AllocationSite sites[MAX_ALLOCATION_SITES];
+    unsigned long frees = 0;
+    unsigned long loopCycles = 0;
+    unsigned long allowedAllocations = 0;
+    unsigned long steadyStateViolations = 0;
+    const void* lastViolationCaller = nullptr;
+    const char* lastViolationScope = nullptr;
+
+    AllocationSubsystem currentSubsystem = ALLOC_LOOP;
+    const char* currentScope = nullptr;
+
+    void begin() {
+        allocationTrackingLoopTask = true;
+    }
+
+    // Must not allocate - it runs inside malloc
+    void record(size_t size, const void* caller) {
+        if (!allocationTrackingLoopTask) {
+            otherTasks.count++;
+            otherTasks.bytes += size;
+            return;
+        }
+        subsystems[currentSubsystem].count++;
+        subsystems[currentSubsystem].bytes += size;
+        AllocationSite* site = findSite(caller);
+        if (site != nullptr) {
+            site->scope = currentScope;
+            site->subsystem = currentSubsystem;
+            site->counter.count++;
+            site->counter.bytes += size;
+        }
+        if (allowanceDepth > 0) {
+            allowancePending++;
+            allowanceCaller = caller;
+            allowanceScope = currentScope;
+            return;
+        }
+        cycleAllocations++;
+        cycleCaller = caller;
+        cycleScope = currentScope;
+    }
+
+    void beginCycle() {
+        cycleAllocations = 0;
+        cycleCaller = nullptr;
+        cycleScope = nullptr;
+    }
+
+    // granted: the code inside serves a request or (re)connects, which also grants the enclosing allowance
+    void beginAllowance(bool granted) {
+        if (allowanceDepth++ == 0) {
+            allowancePending = 0;
+            allowanceGranted = false;
+        }
+        allowanceGranted = allowanceGranted || granted;
+    }
+
+    void endAllowance() {
+        if (--allowanceDepth > 0) {
+            return;
+        }
+        if (allowanceGranted) {
+            allowedAllocations += allowancePending;
+        } else if (allowancePending > 0) {
+            cycleAllocations += allowancePending;
+            cycleCaller = allowanceCaller;
+            cycleScope = allowanceScope;
+        }
+    }
+
+    void endCycle() {
+        loopCycles++;
+        if (cycleAllocations == 0 || millis() < ALLOC_WARMUP_MS) {
+            return;
+        }
+        steadyStateViolations++;
+        lastViolationCaller = cycleCaller;
+        lastViolationScope = cycleScope;
+        char caller[64];
+        formatAllocationCaller(cycleCaller, caller, sizeof(caller));
+        LOG_PRINTF("Steady-state loop() cycle allocated %lu time(s), last from %s in %s\n", cycleAllocations, caller,
+            cycleScope != nullptr ? cycleScope : "loop()");
+    }
+
+    // "0x400d1234" on the ESP32; "program+0x1234" on the host, where the executable is position independent
+    static void formatAllocationCaller(const void* caller, char* text, size_t size) {
+#ifndef ESP_PLATFORM
+        Dl_info info;
+        if (caller != nullptr && dladdr(caller, &info) != 0 && info.dli_fname != nullptr) {
+            const char* file = strrchr(info.dli_fname, '/');
+            snprintf(text, size, "%s+0x%lx", file != nullptr ? file + 1 : info.dli_fname,
+                (unsigned long)((uintptr_t)caller - (uintptr_t)info.dli_fbase));
+            return;
+        }
+#endif
+        snprintf(text, size, "%p", caller);
+    }
+
+private:
+    unsigned long cycleAllocations = 0;
+    const void* cycleCaller = nullptr;
+    const char* cycleScope = nullptr;
+    int allowanceDepth = 0;
+    bool allowanceGranted = false;
+    unsigned long allowancePending = 0;
+    const void* allowanceCaller = nullptr;
+    const char* allowanceScope = nullptr;
+
+    AllocationSite* findSite(const void* caller) {
+        for (int i = 0; i < MAX_ALLOCATION_SITES; i++) {
+            if (sites[i].caller == caller) {
+                return &sites[i];
+            }
+            if (sites[i].caller == nullptr) {
+                sites[i].caller = caller;
+                return &sites[i];
+            }
+        }
+        return nullptr; // table full - still counted per subsystem
+    }
+};
+
+AllocationTracker allocationTracker;
+
+class AllocationScope {
+public:
+    AllocationScope(AllocationSubsystem subsystem, const char* scope)
+        : previousSubsystem(allocationTracker.currentSubsystem), previousScope(allocationTracker.currentScope) {
+        allocationTracker.currentSubsystem = subsystem;
+        allocationTracker.currentScope = scope;
+    }
+    ~AllocationScope() {
+        allocationTracker.currentSubsystem = previousSubsystem;
+        allocationTracker.currentScope = previousScope;
+    }
+
+private:
+    AllocationSubsystem previousSubsystem;
+    const char* previousScope;
+};
+
+class AllocationAllowance {
+public:
+    explicit AllocationAllowance(bool granted) { allocationTracker.beginAllowance(granted); }
+    ~AllocationAllowance() { allocationTracker.endAllowance(); }
+};
+
+class AllocationCycle {
+public:
+    AllocationCycle() { allocationTracker.beginCycle(); }
+    ~AllocationCycle() { allocationTracker.endCycle(); }
+};
+
+extern "C" {
+void* __wrap_malloc(size_t size) {
+    allocationTracker.record(size, allocationCaller(__builtin_return_address(0)));
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    allocationTracker.record(count * size, allocationCaller(__builtin_return_address(0)));
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    allocationTracker.record(size, allocationCaller(__builtin_return_address(0)));
+    return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void* pointer) {
+    if (pointer != nullptr) {
+        allocationTracker.frees++;
+    }
+    __real_free(pointer);
+}
+
+// Read by test_alloc_steady_state, and by the host simulator to fail a run that broke the steady-state guarantee
+unsigned long allocationTrackerSteadyStateViolations() {
+    return allocationTracker.steadyStateViolations;
+}
+}
+
+// libstdc++'s operator new would be the caller of every new - and on the host, where libstdc++ is a
+// shared library, --wrap can't even reach it - so new/delete are replaced and record the code that said new
+#include <new>
+
+static void* allocationTrackedNew(size_t size, const void* caller) {
+    allocationTracker.record(size, caller);
+    return __real_malloc(size != 0 ? size : 1);
+}
+
+static void* allocationCheckedNew(void* pointer) {
+    if (pointer == nullptr) {
+#if __cpp_exceptions
+        throw std::bad_alloc();
+#else
+        abort();
+#endif
+    }
+    return pointer;
+}
+
+void* operator new(size_t size) { return allocationCheckedNew(allocationTrackedNew(size, allocationCaller(__builtin_return_address(0)))); }
+void* operator new[](size_t size) { return allocationCheckedNew(allocationTrackedNew(size, allocationCaller(__builtin_return_address(0)))); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocationTrackedNew(size, allocationCaller(__builtin_return_address(0))); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocationTrackedNew(size, allocationCaller(__builtin_return_address(0))); }
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+
+void printAllocationInfo() {
+    Serial.println();
+    Serial.println("=== Allocation Info ===");
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        Serial.printf("%-12s %8lu allocations %10lu bytes\n", ALLOCATION_SUBSYSTEM_NAMES[i],
+            allocationTracker.subsystems[i].count, allocationTracker.subsystems[i].bytes);
+    }
+    Serial.printf("%-12s %8lu allocations %10lu bytes\n", "otherTasks", allocationTracker.otherTasks.count, allocationTracker.otherTasks.bytes);
+    Serial.printf("Frees: %lu, loop() cycles: %lu, allowed allocations: %lu, steady-state violations: %lu\n",
+        allocationTracker.frees, allocationTracker.loopCycles, allocationTracker.allowedAllocations, allocationTracker.steadyStateViolations);
+    for (int i = 0; i < MAX_ALLOCATION_SITES && allocationTracker.sites[i].caller != nullptr; i++) {
+        const AllocationSite& site = allocationTracker.sites[i];
+        char caller[64];
+        AllocationTracker::formatAllocationCaller(site.caller, caller, sizeof(caller));
+        Serial.printf("  %s in %s [%s] %lu allocations %lu bytes\n", caller, site.scope != nullptr ? site.scope : "loop()",
+            ALLOCATION_SUBSYSTEM_NAMES[site.subsystem], site.counter.count, site.counter.bytes);
+    }
+    Serial.println("=======================");
+    Serial.println();
+}
+
+#define ALLOC_SCOPE(subsystem) AllocationScope allocationScope(subsystem, __FILE__ ":" ALLOC_STRINGIFY(__LINE__))
+#define ALLOC_LOOP_CYCLE() AllocationCycle allocationCycle
+#define ALLOC_ALLOWED() AllocationAllowance allocationAllowance(true)
+#define ALLOC_ALLOWED_IF_SERVED() AllocationAllowance allocationAllowance(false)
+
+#else
+#define ALLOC_SCOPE(subsystem) ((void)0)
+#define ALLOC_LOOP_CYCLE() ((void)0)
+#define ALLOC_ALLOWED() ((void)0)
+#define ALLOC_ALLOWED_IF_SERVED() ((void)0)
+#endif // ALLOC_TRACKING
+
+#endif // ALLOCATION_TRACKER_H
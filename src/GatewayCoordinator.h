@@ -0,0 +1,370 @@
+// GatewayCoordinator.h
+#ifndef GATEWAY_COORDINATOR_H
+#define GATEWAY_COORDINATOR_H
+
+#include <Arduino.h>
+
+// Plain sockets rather than WiFiUDP, whose parsePacket() mallocs a receive buffer on every call
+#include <unistd.h>
+#ifdef ESP_PLATFORM
+#include <lwip/sockets.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <SimulatedMulticast.h> // several simulated gateways share the group on one machine
+#endif
+
+// Internal includes
+#include "ExtremelySimpleLogger.h"
+
+/*
+ * Lets several gateways share one set of sensors without publishing duplicate series.
+ *
+ * Every gateway periodically multicasts what it hears on the LAN: sensor address, smoothed RSSI
+ * and whether it currently holds the connection. From those announcements each gateway decides
+ * locally which sensors it should own:
+ *  - a sensor nobody owns goes to the gateway that hears it best,
+ *  - an owned sensor moves only when another gateway hears it OWNERSHIP_HYSTERESIS_DB better;
+ *    the owner lets go first, since most peripherals accept a single central at a time,
+ *  - a gateway that stays silent for GATEWAY_TIMEOUT_MS loses all its claims.
+ * Two gateways claiming the same sensor at once (e.g. right after boot) is settled by RSSI,
+ * then by gateway id, so both sides reach the same answer.
+ *
+ * Announcement format (plain text, one packet per up to GATEWAY_PACKET_SIZE bytes):
+ *   SHGW1 <gatewayId>
+ *   <address> <rssi> <owned 0|1>
+ *   ...
+ */
+static const uint32_t GATEWAY_MULTICAST_GROUP = 0xEFFF4853; // 239.255.72.83, host byte order
+static const uint16_t GATEWAY_MULTICAST_PORT = 47283;
+static const char GATEWAY_PACKET_HEADER[] = "SHGW1";
+static const size_t GATEWAY_PACKET_SIZE = 1024;
+
+static const unsigned long GATEWAY_ANNOUNCE_INTERVAL_MS = 5000;
+static const unsigned long GATEWAY_TIMEOUT_MS = 3 * GATEWAY_ANNOUNCE_INTERVAL_MS;
+static const unsigned long OBSERVATION_TTL_MS = 30000;
+static const int OWNERSHIP_HYSTERESIS_DB = 6;
+
+static const int MAX_REMOTE_GATEWAYS = 8;
+#ifndef MAX_COORDINATED_SENSORS
+#define MAX_COORDINATED_SENSORS 32
+#endif
+static const size_t GATEWAY_ID_LENGTH = 24;
+static const size_t SENSOR_ADDRESS_LENGTH = 18; // "aa:bb:cc:dd:ee:ff" + '\0'
+
+struct SensorObservation {
+  int rssi;
+  bool owned;
+  unsigned long seenAt; // 0 = never seen
+
+  SensorObservation() : rssi(0), owned(false), seenAt(0) {}
+};
+
+struct CoordinatedSensor {
+  char address[SENSOR_ADDRESS_LENGTH];
+  SensorObservation local;
+  SensorObservation remote[MAX_REMOTE_GATEWAYS]; // indexed like GatewayCoordinator::gateways
+
+  CoordinatedSensor() : address{0} {}
+};
+
+struct RemoteGateway {
+  char id[GATEWAY_ID_LENGTH];
+  unsigned long lastHeard; // 0 = free slot
+
+  RemoteGateway() : id{0}, lastHeard(0) {}
+};
+
+class GatewayCoordinator {
+private:
+    int udpSocket = -1;
+    char gatewayId[GATEWAY_ID_LENGTH] = {0};
+    RemoteGateway gateways[MAX_REMOTE_GATEWAYS];
+    CoordinatedSensor sensors[MAX_COORDINATED_SENSORS];
+    char packet[GATEWAY_PACKET_SIZE + 1];
+    unsigned long startedAt = 0;
+    unsigned long lastAnnounce = 0;
+    bool announcedOnce = false;
+
+    static bool isFresh(const SensorObservation& observation, unsigned long now, unsigned long ttl) {
+        return observation.seenAt != 0 && now - observation.seenAt < ttl;
+    }
+
+    static unsigned long ageOf(const SensorObservation& observation, unsigned long now) {
+        return observation.seenAt == 0 ? ULONG_MAX : now - observation.seenAt;
+    }
+
+    bool isAlive(int gatewayIndex, unsigned long now) const {
+        return gateways[gatewayIndex].lastHeard != 0 && now - gateways[gatewayIndex].lastHeard < GATEWAY_TIMEOUT_MS;
+    }
+
+    int findSensor(const char* address) const {
+        for (int i = 0; i < MAX_COORDINATED_SENSORS; i++) {
+            if (strcmp(sensors[i].address, address) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // Finds the sensor entry or takes over the one heard from least recently
+    int findOrAddSensor(const char* address) {
+        int index = findSensor(address);
+        if (index >= 0) {
+            return index;
+        }
+        unsigned long now = millis();
+        unsigned long oldestAge = 0;
+        for (int i = 0; i < MAX_COORDINATED_SENSORS; i++) {
+            if (sensors[i].address[0] == '\0') {
+                index = i;
+                break;
+            }
+            if (sensors[i].local.owned) {
+                continue; // never forget a sensor we hold the connection to
+            }
+            unsigned long age = ageOf(sensors[i].local, now);
+            for (int g = 0; g < MAX_REMOTE_GATEWAYS; g++) {
+                age = min(age, ageOf(sensors[i].remote[g], now));
+            }
+            if (index < 0 || age > oldestAge) {
+                index = i;
+                oldestAge = age;
+            }
+        }
+        if (index < 0) {
+            return -1;
+        }
+        sensors[index] = CoordinatedSensor();
+        strncpy(sensors[index].address, address, SENSOR_ADDRESS_LENGTH - 1);
+        return index;
+    }
+
+    int findOrAddGateway(const char* id, unsigned long now) {
+        int freeIndex = -1;
+        for (int g = 0; g < MAX_REMOTE_GATEWAYS; g++) {
+            if (gateways[g].lastHeard != 0 && strcmp(gateways[g].id, id) == 0) {
+                return g;
+            }
+            if (freeIndex < 0 && !isAlive(g, now)) {
+                freeIndex = g;
+            }
+        }
+        if (freeIndex < 0) {
+            return -1;
+        }
+        // Slot may have belonged to a gateway that went silent - drop everything it told us
+        for (int i = 0; i < MAX_COORDINATED_SENSORS; i++) {
+            sensors[i].remote[freeIndex] = SensorObservation();
+        }
+        gateways[freeIndex] = RemoteGateway();
+        strncpy(gateways[freeIndex].id, id, GATEWAY_ID_LENGTH - 1);
+        LOG_PRINTF("Gateway %s joined\n", gateways[freeIndex].id);
+        return freeIndex;
+    }
+
+    // Strongest live remote gateway that currently hears (or, with claimsOnly, owns) the sensor
+    int strongestRemote(const CoordinatedSensor& sensor, unsigned long now, bool claimsOnly) const {
+        int best = -1;
+        for (int g = 0; g < MAX_REMOTE_GATEWAYS; g++) {
+            const SensorObservation& observation = sensor.remote[g];
+            if (!isAlive(g, now) || !isFresh(observation, now, GATEWAY_TIMEOUT_MS) || (claimsOnly && !observation.owned)) {
+                continue;
+            }
+            if (best < 0 || beats(observation.rssi, gateways[g].id, sensor.remote[best].rssi, gateways[best].id)) {
+                best = g;
+            }
+        }
+        return best;
+    }
+
+    static bool beats(int rssi, const char* id, int otherRssi, const char* otherId) {
+        return rssi > otherRssi || (rssi == otherRssi && strcmp(id, otherId) < 0);
+    }
+
+    void handlePacket(int length, unsigned long now) {
+        packet[length] = '\0';
+        char* savePtr = nullptr;
+        char* line = strtok_r(packet, "\n", &savePtr);
+        if (line == nullptr || strncmp(line, GATEWAY_PACKET_HEADER, sizeof(GATEWAY_PACKET_HEADER) - 1) != 0 ||
+            line[sizeof(GATEWAY_PACKET_HEADER) - 1] != ' ') {
+            return;
+        }
+        const char* senderId = line + sizeof(GATEWAY_PACKET_HEADER);
+        if (*senderId == '\0' || strcmp(senderId, gatewayId) == 0) {
+            return; // malformed or our own announcement looped back
+        }
+        int g = findOrAddGateway(senderId, now);
+        if (g < 0) {
+            LOG_PRINTF("No room for gateway %s\n", senderId);
+            return;
+        }
+        gateways[g].lastHeard = now;
+
+        while ((line = strtok_r(nullptr, "\n", &savePtr)) != nullptr) {
+            char address[SENSOR_ADDRESS_LENGTH];
+            int rssi;
+            int owned;
+            if (sscanf(line, "%17s %d %d", address, &rssi, &owned) != 3) {
+                continue;
+            }
+            int index = findOrAddSensor(address);
+            if (index < 0) {
+                continue;
+            }
+            sensors[index].remote[g].rssi = rssi;
+            sensors[index].remote[g].owned = owned != 0;
+            sensors[index].remote[g].seenAt = now;
+        }
+    }
+
+    void announce(unsigned long now) {
+        size_t headerLength = snprintf(packet, sizeof(packet), "%s %s\n", GATEWAY_PACKET_HEADER, gatewayId);
+        size_t length = headerLength;
+        for (int i = 0; i < MAX_COORDINATED_SENSORS; i++) {
+            const CoordinatedSensor& sensor = sensors[i];
+            if (sensor.address[0] == '\0' || !isFresh(sensor.local, now, OBSERVATION_TTL_MS)) {
+                continue;
+            }
+            char line[40];
+            size_t lineLength = snprintf(line, sizeof(line), "%s %d %d\n", sensor.address, sensor.local.rssi, sensor.local.owned ? 1 : 0);
+            if (length + lineLength > GATEWAY_PACKET_SIZE) {
+                sendPacket(length);
+                length = headerLength;
+            }
+            memcpy(packet + length, line, lineLength);
+            length += lineLength;
+        }
+        // Always send at least the header - it doubles as our heartbeat
+        sendPacket(length);
+    }
+
+    void sendPacket(size_t length) {
+        if (udpSocket < 0) {
+            return;
+        }
+        sockaddr_in group = {};
+        group.sin_family = AF_INET;
+        group.sin_port = htons(GATEWAY_MULTICAST_PORT);
+        group.sin_addr.s_addr = htonl(GATEWAY_MULTICAST_GROUP);
+        sendto(udpSocket, packet, length, 0, reinterpret_cast<sockaddr*>(&group), sizeof(group));
+    }
+
+    bool joinMulticastGroup() {
+        udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (udpSocket < 0) {
+            return false;
+        }
+        in_addr interfaceAddress = {};
+        interfaceAddress.s_addr = htonl(INADDR_ANY);
+#ifndef ESP_PLATFORM
+        interfaceAddress = configureSimulatedMulticast(udpSocket);
+#endif
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(GATEWAY_MULTICAST_PORT);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        ip_mreq membership = {};
+        membership.imr_multiaddr.s_addr = htonl(GATEWAY_MULTICAST_GROUP);
+        membership.imr_interface = interfaceAddress;
+        if (bind(udpSocket, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 ||
+            setsockopt(udpSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+            close(udpSocket);
+            udpSocket = -1;
+            return false;
+        }
+        return true;
+    }
+
+public:
+    ~GatewayCoordinator() {
+        if (udpSocket >= 0) {
+            close(udpSocket);
+        }
+    }
+
+    void setup(const String& id) {
+        strncpy(gatewayId, id.c_str(), GATEWAY_ID_LENGTH - 1);
+        startedAt = millis();
+        if (!joinMulticastGroup()) {
+            LOG_LN("Failed to join gateway multicast group!");
+        }
+    }
+
+    const char* getGatewayId() const {
+        return gatewayId;
+    }
+
+    // Handles one announcement as if it had arrived over UDP
+    void receive(const char* announcement) {
+        size_t length = min(strlen(announcement), GATEWAY_PACKET_SIZE);
+        memcpy(packet, announcement, length);
+        handlePacket(length, millis());
+    }
+
+    // Receive announcements from other gateways and send ours when it's due
+    void loop() {
+        unsigned long now = millis();
+        ssize_t length;
+        // Straight into the packet buffer; MSG_DONTWAIT returns at once when nothing is waiting
+        while (udpSocket >= 0 && (length = recvfrom(udpSocket, packet, GATEWAY_PACKET_SIZE, MSG_DONTWAIT, nullptr, nullptr)) > 0) {
+            handlePacket(length, now);
+        }
+        if (!announcedOnce || now - lastAnnounce >= GATEWAY_ANNOUNCE_INTERVAL_MS) {
+            announcedOnce = true;
+            lastAnnounce = now;
+            announce(now);
+        }
+    }
+
+    // Record RSSI we've just measured, smoothed so a single noisy reading can't steal a sensor
+    void observe(const char* address, int rssi) {
+        int index = findOrAddSensor(address);
+        if (index < 0) {
+            return;
+        }
+        SensorObservation& local = sensors[index].local;
+        unsigned long now = millis();
+        local.rssi = isFresh(local, now, OBSERVATION_TTL_MS) ? (3 * local.rssi + rssi) / 4 : rssi;
+        local.seenAt = now;
+    }
+
+    void setOwned(const char* address, bool owned) {
+        int index = owned ? findOrAddSensor(address) : findSensor(address);
+        if (index >= 0) {
+            sensors[index].local.owned = owned;
+        }
+    }
+
+    bool shouldOwn(const char* address) {
+        unsigned long now = millis();
+        int index = findSensor(address);
+        if (index < 0) {
+            return false;
+        }
+        const CoordinatedSensor& sensor = sensors[index];
+        if (sensor.local.owned) {
+            // Another gateway also holds it (e.g. right after boot) and wins the tie-break
+            int claimer = strongestRemote(sensor, now, true);
+            if (claimer >= 0 && beats(sensor.remote[claimer].rssi, gateways[claimer].id, sensor.local.rssi, gatewayId)) {
+                return false;
+            }
+            // Break before make: the better gateway can only connect once we've disconnected
+            int observer = strongestRemote(sensor, now, false);
+            return observer < 0 || sensor.remote[observer].rssi < sensor.local.rssi + OWNERSHIP_HYSTERESIS_DB;
+        }
+        // Give other gateways two announcement rounds to tell us what they hear before grabbing anything
+        if (now - startedAt < 2 * GATEWAY_ANNOUNCE_INTERVAL_MS || !isFresh(sensor.local, now, OBSERVATION_TTL_MS)) {
+            return false;
+        }
+        int owner = strongestRemote(sensor, now, true);
+        if (owner >= 0) {
+            return sensor.local.rssi >= sensor.remote[owner].rssi + OWNERSHIP_HYSTERESIS_DB;
+        }
+        int observer = strongestRemote(sensor, now, false);
+        return observer < 0 || beats(sensor.local.rssi, gatewayId, sensor.remote[observer].rssi, gateways[observer].id);
+    }
+};
+
+#endif // GATEWAY_COORDINATOR_H
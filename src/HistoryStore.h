@@ -0,0 +1,449 @@
+// HistoryStore.h
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <Arduino.h>
+#include <time.h>
+
+// Internal includes
+#include "ExtremelySimpleLogger.h"
+#include "SensorState.h"
+
+/*
+ * On-device history of temperature, humidity and CO2 per sensor, so the dashboard still has
+ * something to show while InfluxDB or Grafana is down.
+ *
+ * Samples are compressed the way Facebook's Gorilla does it:
+ *  - timestamps as delta-of-delta: '0' when the interval didn't change, otherwise a prefix
+ *    picking a 7, 9, 12 or 32 bit field,
+ *  - values as the XOR with the previous float: '0' when equal, '10' when the meaningful bits
+ *    fit the previous leading/trailing zero window, '11' + 5 bit leading zeros + 5 bit length
+ *    otherwise.
+ * Sampling every HISTORY_SAMPLE_INTERVAL_MS keeps most timestamps at one bit, so a series costs
+ * roughly 2-3 bytes per sample and the default arena holds several days for a house full of sensors.
+ *
+ * The arena is one allocation (PSRAM when available) split into HistoryBlocks. Every block is a
+ * self-contained stream starting with a raw timestamp and value, so readers can skip whole blocks
+ * by their time range. Blocks are handed out round-robin; once the arena is full the next block in
+ * line is the oldest one anywhere, and it is taken from the front of its series.
+ */
+enum HistoryQuantity {
+  HISTORY_TEMPERATURE = 0,
+  HISTORY_HUMIDITY,
+  HISTORY_CO2,
+  HISTORY_QUANTITY_COUNT
+};
+
+static const char* const HISTORY_QUANTITY_NAMES[HISTORY_QUANTITY_COUNT] = {"temperature", "humidity", "co2"};
+
+static const unsigned long HISTORY_SAMPLE_INTERVAL_MS = 60000;
+static const uint32_t HISTORY_SAMPLE_INTERVAL_S = HISTORY_SAMPLE_INTERVAL_MS / 1000;
+static const time_t HISTORY_MIN_VALID_TIME = 1577836800; // 2020-01-01, earlier means NTP hasn't synced yet
+static const size_t HISTORY_BLOCK_BYTES = 256;
+static const uint16_t HISTORY_MAX_SAMPLE_BITS = 4 + 32 + 2 + 5 + 5 + 32; // worst case timestamp + value
+static const size_t HISTORY_ADDRESS_LENGTH = 18; // "aa:bb:cc:dd:ee:ff" + '\0'
+
+#ifndef HISTORY_ARENA_BYTES
+#define HISTORY_ARENA_BYTES (512 * 1024)
+#endif
+#ifndef HISTORY_FALLBACK_ARENA_BYTES
+#define HISTORY_FALLBACK_ARENA_BYTES (32 * 1024) // boards without PSRAM
+#endif
+// One slot per sensor the gateway can hold at once; a sensor beyond that evicts the quietest one and
+// its history with it. Each sensor needs a block per quantity it reports, so the arena should hold
+// at least HISTORY_QUANTITY_COUNT blocks per sensor, setup() warns when it doesn't
+#ifndef HISTORY_MAX_SENSORS
+#define HISTORY_MAX_SENSORS MAX_FOUND_PERIPHERALS
+#endif
+static_assert(HISTORY_MAX_SENSORS * HISTORY_QUANTITY_COUNT <= INT16_MAX, "series are indexed with int16_t");
+
+struct HistoryBlock {
+  int16_t next;    // newer block of the same series, -1 = none
+  int16_t series;  // owning series, -1 = free
+  uint16_t count;
+  uint16_t bitLength;
+  uint32_t firstTimestamp;
+  uint32_t lastTimestamp;
+  uint8_t data[HISTORY_BLOCK_BYTES];
+};
+
+struct HistorySeries {
+  int16_t head; // oldest block, -1 = empty
+  int16_t tail; // block being appended to
+  // Encoder state at the end of the tail block
+  uint32_t previousTimestamp;
+  int32_t previousDelta;
+  uint32_t previousValue;
+  uint8_t previousLeading;
+  uint8_t previousTrailing;
+
+  HistorySeries() : head(-1), tail(-1), previousTimestamp(0), previousDelta(0), previousValue(0), previousLeading(0), previousTrailing(0) {}
+};
+
+struct HistorySensor {
+  char address[HISTORY_ADDRESS_LENGTH];
+  uint32_t lastTimestamp; // newest sample of any series, 0 = free slot
+  HistorySeries series[HISTORY_QUANTITY_COUNT];
+
+  HistorySensor() : address{0}, lastTimestamp(0) {}
+};
+
+static inline void writeHistoryBits(HistoryBlock& block, uint32_t value, uint8_t bits) {
+  for (int i = bits - 1; i >= 0; i--) {
+    if ((value >> i) & 1) {
+      block.data[block.bitLength >> 3] |= 0x80 >> (block.bitLength & 7);
+    }
+    block.bitLength++;
+  }
+}
+
+static inline uint32_t readHistoryBits(const HistoryBlock& block, uint16_t& position, uint8_t bits) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < bits; i++) {
+    value = (value << 1) | ((block.data[position >> 3] >> (7 - (position & 7))) & 1);
+    position++;
+  }
+  return value;
+}
+
+static inline uint32_t historyFloatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline float historyBitsFloat(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Decodes one series between two timestamps, oldest first, without allocating
+class HistoryCursor {
+private:
+    const HistoryBlock* blocks = nullptr;
+    int16_t block = -1;
+    uint16_t decoded = 0;
+    uint16_t position = 0;
+    uint32_t from = 0;
+    uint32_t to = 0;
+    uint32_t timestamp = 0;
+    int32_t delta = 0;
+    uint32_t value = 0;
+    uint8_t leading = 0;
+    uint8_t trailing = 0;
+
+    int32_t readDeltaOfDelta() {
+      if (readHistoryBits(blocks[block], position, 1) == 0) {
+        return 0;
+      }
+      if (readHistoryBits(blocks[block], position, 1) == 0) {
+        return (int32_t)readHistoryBits(blocks[block], position, 7) - 63;
+      }
+      if (readHistoryBits(blocks[block], position, 1) == 0) {
+        return (int32_t)readHistoryBits(blocks[block], position, 9) - 255;
+      }
+      if (readHistoryBits(blocks[block], position, 1) == 0) {
+        return (int32_t)readHistoryBits(blocks[block], position, 12) - 2047;
+      }
+      return (int32_t)readHistoryBits(blocks[block], position, 32);
+    }
+
+    void readXor() {
+      if (readHistoryBits(blocks[block], position, 1) == 0) {
+        return; // same value
+      }
+      if (readHistoryBits(blocks[block], position, 1) == 1) {
+        leading = readHistoryBits(blocks[block], position, 5);
+        trailing = 32 - leading - (readHistoryBits(blocks[block], position, 5) + 1);
+      }
+      value ^= readHistoryBits(blocks[block], position, 32 - leading - trailing) << trailing;
+    }
+
+    // Advances to the next block that can hold samples at or after `from`
+    void skipToBlock(int16_t index) {
+      block = index;
+      while (block >= 0 && blocks[block].lastTimestamp < from) {
+        block = blocks[block].next;
+      }
+      decoded = 0;
+      position = 0;
+    }
+
+public:
+    HistoryCursor() {}
+
+    HistoryCursor(const HistoryBlock* blocks, int16_t head, uint32_t from, uint32_t to) : blocks(blocks), from(from), to(to) {
+      skipToBlock(head);
+    }
+
+    bool next(uint32_t& sampleTimestamp, float& sampleValue) {
+      while (block >= 0) {
+        const HistoryBlock& current = blocks[block];
+        if (current.firstTimestamp > to) {
+          block = -1;
+          break;
+        }
+        if (decoded == current.count) {
+          skipToBlock(current.next);
+          continue;
+        }
+        if (decoded == 0) {
+          timestamp = readHistoryBits(current, position, 32);
+          value = readHistoryBits(current, position, 32);
+          delta = HISTORY_SAMPLE_INTERVAL_S;
+          leading = 0;
+          trailing = 0;
+        } else {
+          delta += readDeltaOfDelta();
+          timestamp += delta;
+          readXor();
+        }
+        decoded++;
+        if (timestamp > to) {
+          block = -1;
+          break;
+        }
+        if (timestamp >= from) {
+          sampleTimestamp = timestamp;
+          sampleValue = historyBitsFloat(value);
+          return true;
+        }
+      }
+      return false;
+    }
+};
+
+struct HistoryBucket {
+  uint32_t start;
+  float minimum;
+  float maximum;
+  float average;
+};
+
+// Folds the samples of a cursor into step wide buckets aligned to `from`, for server-side downsampling
+class HistoryDownsampler {
+private:
+    HistoryCursor& cursor;
+    uint32_t from;
+    uint32_t step;
+    bool pending = false;
+    uint32_t pendingTimestamp = 0;
+    float pendingValue = 0;
+
+public:
+    HistoryDownsampler(HistoryCursor& cursor, uint32_t from, uint32_t step) : cursor(cursor), from(from), step(step > 0 ? step : 1) {
+      pending = cursor.next(pendingTimestamp, pendingValue);
+    }
+
+    bool next(HistoryBucket& bucket) {
+      if (!pending) {
+        return false;
+      }
+      bucket.start = from + (pendingTimestamp - from) / step * step;
+      bucket.minimum = pendingValue;
+      bucket.maximum = pendingValue;
+      double sum = 0;
+      uint32_t count = 0;
+      while (pending && pendingTimestamp - bucket.start < step) {
+        bucket.minimum = min(bucket.minimum, pendingValue);
+        bucket.maximum = max(bucket.maximum, pendingValue);
+        sum += pendingValue;
+        count++;
+        pending = cursor.next(pendingTimestamp, pendingValue);
+      }
+      bucket.average = sum / count;
+      return true;
+    }
+};
+
+class HistoryStore {
+private:
+    HistoryBlock* blocks = nullptr;
+    int16_t blockCount = 0;
+    int16_t nextBlock = 0;
+    int16_t usedBlocks = 0;
+    HistorySensor sensors[HISTORY_MAX_SENSORS];
+
+    HistorySeries& seriesAt(int16_t index) {
+      return sensors[index / HISTORY_QUANTITY_COUNT].series[index % HISTORY_QUANTITY_COUNT];
+    }
+
+    // Finds the sensor or takes over the slot that has been quiet the longest
+    int findOrAddSensor(const char* address) {
+      int index = findSensor(address);
+      if (index >= 0) {
+        return index;
+      }
+      for (int i = 0; i < HISTORY_MAX_SENSORS; i++) {
+        if (sensors[i].lastTimestamp == 0) {
+          index = i;
+          break;
+        }
+        if (index < 0 || sensors[i].lastTimestamp < sensors[index].lastTimestamp) {
+          index = i;
+        }
+      }
+      // Orphan the old sensor's blocks; they get recycled in turn
+      for (int q = 0; q < HISTORY_QUANTITY_COUNT; q++) {
+        for (int16_t b = sensors[index].series[q].head; b >= 0; b = blocks[b].next) {
+          blocks[b].series = -1;
+        }
+      }
+      sensors[index] = HistorySensor();
+      strncpy(sensors[index].address, address, HISTORY_ADDRESS_LENGTH - 1);
+      return index;
+    }
+
+    // Round-robin, so once the arena is full the block handed out is the oldest one and heads its series
+    int16_t allocateBlock(int16_t seriesIndex, uint32_t timestamp) {
+      int16_t index = nextBlock;
+      nextBlock = (nextBlock + 1) % blockCount;
+      HistoryBlock& block = blocks[index];
+      if (block.series >= 0) {
+        HistorySeries& owner = seriesAt(block.series);
+        owner.head = block.next;
+        if (owner.tail == index) {
+          owner.tail = -1;
+        }
+      } else if (usedBlocks < blockCount) {
+        usedBlocks++;
+      }
+      memset(&block, 0, sizeof(block));
+      block.next = -1;
+      block.series = seriesIndex;
+      block.firstTimestamp = timestamp;
+
+      HistorySeries& series = seriesAt(seriesIndex);
+      if (series.tail >= 0) {
+        blocks[series.tail].next = index;
+      } else {
+        series.head = index;
+      }
+      series.tail = index;
+      return index;
+    }
+
+public:
+    bool setup() {
+      size_t arenaBytes = psramFound() ? HISTORY_ARENA_BYTES : HISTORY_FALLBACK_ARENA_BYTES;
+      blockCount = min(arenaBytes / sizeof(HistoryBlock), (size_t)INT16_MAX);
+      blocks = static_cast<HistoryBlock*>(psramFound() ? ps_malloc(blockCount * sizeof(HistoryBlock)) : malloc(blockCount * sizeof(HistoryBlock)));
+      if (blocks == nullptr) {
+        LOG_LN("History arena allocation failed, history disabled");
+        blockCount = 0;
+        return false;
+      }
+      for (int16_t i = 0; i < blockCount; i++) {
+        blocks[i].series = -1;
+        blocks[i].next = -1;
+      }
+      LOG_PRINTF("History arena: %d blocks, %u bytes\n", blockCount, (unsigned)(blockCount * sizeof(HistoryBlock)));
+      if (blockCount < HISTORY_MAX_SENSORS * HISTORY_QUANTITY_COUNT) {
+        LOG_PRINTF("History arena is too small for %d sensors, series will be cut short\n", HISTORY_MAX_SENSORS);
+      }
+      return true;
+    }
+
+    int findSensor(const char* address) const {
+      for (int i = 0; i < HISTORY_MAX_SENSORS; i++) {
+        if (sensors[i].lastTimestamp != 0 && strcmp(sensors[i].address, address) == 0) {
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    // Appends a sample; timestamps must grow, anything older than the last sample is dropped,
+    // and so are NaN/Inf, which would break the averages and aren't valid JSON
+    void record(const char* address, HistoryQuantity quantity, float value, uint32_t timestamp) {
+      if (blockCount == 0 || !isfinite(value)) {
+        return;
+      }
+      int sensorIndex = findOrAddSensor(address);
+      int16_t seriesIndex = sensorIndex * HISTORY_QUANTITY_COUNT + quantity;
+      HistorySeries& series = seriesAt(seriesIndex);
+      if (series.tail >= 0 && timestamp <= series.previousTimestamp) {
+        return;
+      }
+      sensors[sensorIndex].lastTimestamp = max(sensors[sensorIndex].lastTimestamp, timestamp);
+
+      uint32_t bits = historyFloatBits(value);
+      if (series.tail < 0 || blocks[series.tail].bitLength + HISTORY_MAX_SAMPLE_BITS > (int)(HISTORY_BLOCK_BYTES * 8)) {
+        HistoryBlock& block = blocks[allocateBlock(seriesIndex, timestamp)];
+        writeHistoryBits(block, timestamp, 32);
+        writeHistoryBits(block, bits, 32);
+        block.count = 1;
+        block.lastTimestamp = timestamp;
+        series.previousTimestamp = timestamp;
+        series.previousDelta = HISTORY_SAMPLE_INTERVAL_S;
+        series.previousValue = bits;
+        series.previousLeading = 0;
+        series.previousTrailing = 0;
+        return;
+      }
+
+      HistoryBlock& block = blocks[series.tail];
+      int32_t delta = timestamp - series.previousTimestamp;
+      int32_t deltaOfDelta = delta - series.previousDelta;
+      if (deltaOfDelta == 0) {
+        writeHistoryBits(block, 0b0, 1);
+      } else if (deltaOfDelta >= -63 && deltaOfDelta <= 64) {
+        writeHistoryBits(block, 0b10, 2);
+        writeHistoryBits(block, deltaOfDelta + 63, 7);
+      } else if (deltaOfDelta >= -255 && deltaOfDelta <= 256) {
+        writeHistoryBits(block, 0b110, 3);
+        writeHistoryBits(block, deltaOfDelta + 255, 9);
+      } else if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048) {
+        writeHistoryBits(block, 0b1110, 4);
+        writeHistoryBits(block, deltaOfDelta + 2047, 12);
+      } else {
+        writeHistoryBits(block, 0b1111, 4);
+        writeHistoryBits(block, (uint32_t)deltaOfDelta, 32);
+      }
+
+      uint32_t xorValue = bits ^ series.previousValue;
+      if (xorValue == 0) {
+        writeHistoryBits(block, 0b0, 1);
+      } else {
+        uint8_t leading = __builtin_clz(xorValue);
+        uint8_t trailing = __builtin_ctz(xorValue);
+        bool fitsWindow = (series.previousLeading != 0 || series.previousTrailing != 0) &&
+          leading >= series.previousLeading && trailing >= series.previousTrailing;
+        if (fitsWindow) {
+          writeHistoryBits(block, 0b10, 2);
+        } else {
+          writeHistoryBits(block, 0b11, 2);
+          writeHistoryBits(block, leading, 5);
+          writeHistoryBits(block, 32 - leading - trailing - 1, 5);
+          series.previousLeading = leading;
+          series.previousTrailing = trailing;
+        }
+        uint8_t meaningful = 32 - series.previousLeading - series.previousTrailing;
+        writeHistoryBits(block, xorValue >> series.previousTrailing, meaningful);
+      }
+
+      block.count++;
+      block.lastTimestamp = timestamp;
+      series.previousTimestamp = timestamp;
+      series.previousDelta = delta;
+      series.previousValue = bits;
+    }
+
+    HistoryCursor cursor(int sensorIndex, HistoryQuantity quantity, uint32_t from, uint32_t to) const {
+      if (sensorIndex < 0 || sensorIndex >= HISTORY_MAX_SENSORS) {
+        return HistoryCursor();
+      }
+      return HistoryCursor(blocks, sensors[sensorIndex].series[quantity].head, from, to);
+    }
+
+    int getBlockCount() const {
+      return blockCount;
+    }
+
+    int getUsedBlocks() const {
+      return usedBlocks;
+    }
+};
+
+#endif // HISTORY_STORE_H
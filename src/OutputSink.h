@@ -0,0 +1,190 @@
+// OutputSink.h
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <Arduino.h>
+
+// Internal includes
+#include "ExtremelySimpleLogger.h"
+
+/*
+ * Everything a gateway publishes goes through OutputSinks: the publish path hands each reading
+ * to OutputSinks::publish(), which copies it into a queue per sink, and OutputSinks::loop() feeds
+ * every queue to its sink on its own schedule. A sink that fails is backed off exponentially
+ * (SINK_MIN_BACKOFF_MS doubling up to SINK_MAX_BACKOFF_MS) while its queue keeps the newest
+ * readings, so an unreachable InfluxDB neither delays MQTT nor loses the last few minutes.
+ *
+ * Readings leave a queue only after the sink confirmed them: write() for every reading of a
+ * batch, then flush() for the batch as a whole. A reading the sink refuses for good (HTTP 4xx
+ * other than 429) or that doesn't fit even an empty batch is dropped and counted instead, so it
+ * can't block the queue behind it forever.
+ */
+static const size_t READING_ADDRESS_LENGTH = 18; // "aa:bb:cc:dd:ee:ff" + '\0'
+static const size_t READING_LOCATION_LENGTH = 32;
+
+struct SensorReading {
+  char deviceId[READING_ADDRESS_LENGTH];
+  char location[READING_LOCATION_LENGTH];
+  float temperature;
+  float humidity;
+  int co2;
+  int battery;
+  int rssi;
+  uint32_t timestamp; // seconds since epoch, taken when the reading was queued
+
+  SensorReading() : deviceId{0}, location{0}, temperature(NAN), humidity(NAN), co2(-1), battery(-1), rssi(0), timestamp(0) {}
+};
+
+// What write() did with a reading
+enum SinkWriteResult {
+  SINK_WRITE_OK,       // delivered, or buffered for flush()
+  SINK_WRITE_FULL,     // nothing more fits this batch: flush it, the reading goes into the next one (dropped if the batch was empty)
+  SINK_WRITE_FAILED,   // the sink is down and dropped what it buffered, the batch stays queued for a retry
+  SINK_WRITE_REJECTED  // the sink will never take this reading, it leaves the queue
+};
+
+class OutputSink {
+public:
+    virtual ~OutputSink() {}
+
+    virtual const char* getName() const = 0;
+    // Opens or re-opens the connection; OutputSinks calls it again after a backoff when it fails
+    virtual bool connect() = 0;
+    virtual bool isConnected() = 0;
+    // Delivers or buffers one reading. A sink that buffers must not send anything before flush(),
+    // so a failed batch leaves exactly its readings queued
+    virtual SinkWriteResult write(const SensorReading& reading) = 0;
+    // Sends whatever write() buffered; false keeps the buffered readings queued
+    virtual bool flush() { return true; }
+    // Called every loop() for keep-alives and incoming traffic
+    virtual void loop() {}
+    // How many readings one batch may hold and how long to wait between batches
+    virtual size_t getBatchSize() const { return 1; }
+    virtual unsigned long getBatchIntervalMs() const { return 0; }
+};
+
+#ifndef OUTPUT_SINK_QUEUE_LENGTH
+#define OUTPUT_SINK_QUEUE_LENGTH 32
+#endif
+static const int MAX_OUTPUT_SINKS = 3;
+static const unsigned long SINK_MIN_BACKOFF_MS = 1000;
+static const unsigned long SINK_MAX_BACKOFF_MS = 300000;
+
+struct OutputSinkState {
+  OutputSink* sink;
+  SensorReading queue[OUTPUT_SINK_QUEUE_LENGTH];
+  size_t head;
+  size_t count;
+  unsigned long delivered;
+  unsigned long dropped;    // pushed out of a full queue before they could be delivered
+  unsigned long rejected;   // refused by the sink for good, or too big for any batch
+  unsigned int failures;    // consecutive, 0 = healthy
+  unsigned long failedAt;
+  unsigned long backoffMs;
+  unsigned long lastBatchAt;
+
+  OutputSinkState() : sink(nullptr), head(0), count(0), delivered(0), dropped(0), rejected(0), failures(0), failedAt(0), backoffMs(0), lastBatchAt(0) {}
+};
+
+class OutputSinks {
+private:
+    OutputSinkState sinks[MAX_OUTPUT_SINKS];
+    int sinkCount = 0;
+
+    void fail(OutputSinkState& state, unsigned long now) {
+      state.failures++;
+      state.failedAt = now;
+      state.backoffMs = min(SINK_MIN_BACKOFF_MS << min(state.failures - 1, 10u), SINK_MAX_BACKOFF_MS);
+      LOG_PRINTF("%s sink failed %u time(s), %u reading(s) queued, retrying in %lu ms\n",
+        state.sink->getName(), state.failures, (unsigned)state.count, state.backoffMs);
+    }
+
+    void deliver(OutputSinkState& state, unsigned long now) {
+      if (state.failures > 0 && now - state.failedAt < state.backoffMs) {
+        return;
+      }
+      if (!state.sink->isConnected() && !state.sink->connect()) {
+        fail(state, now);
+        return;
+      }
+      // Rejected or oversized readings at the front of the queue leave right away, the rest wait for flush()
+      size_t batch = min(state.count, state.sink->getBatchSize());
+      size_t written = 0;
+      SinkWriteResult result = SINK_WRITE_OK;
+      while (written < batch) {
+        result = state.sink->write(state.queue[(state.head + written) % OUTPUT_SINK_QUEUE_LENGTH]);
+        // A reading that doesn't fit even an empty batch never will, so it goes like a rejected one
+        if ((result == SINK_WRITE_REJECTED || result == SINK_WRITE_FULL) && written == 0) {
+          LOG_PRINTF("%s sink %s a reading of %s, dropping it\n", state.sink->getName(),
+            result == SINK_WRITE_FULL ? "can't fit" : "rejected", state.queue[state.head].deviceId);
+          state.head = (state.head + 1) % OUTPUT_SINK_QUEUE_LENGTH;
+          state.count--;
+          state.rejected++;
+          batch--;
+          continue;
+        }
+        if (result != SINK_WRITE_OK) {
+          break;
+        }
+        written++;
+      }
+      state.lastBatchAt = now;
+      // A rejection behind written readings ends the batch; the reading is retried, and dropped, at the front of the next one
+      if (result == SINK_WRITE_FAILED || !state.sink->flush()) {
+        fail(state, now);
+        return;
+      }
+      state.head = (state.head + written) % OUTPUT_SINK_QUEUE_LENGTH;
+      state.count -= written;
+      state.delivered += written;
+      if (state.failures > 0) {
+        LOG_PRINTF("%s sink recovered\n", state.sink->getName());
+        state.failures = 0;
+      }
+    }
+
+public:
+    bool add(OutputSink& sink) {
+      if (sinkCount == MAX_OUTPUT_SINKS) {
+        return false;
+      }
+      sinks[sinkCount++].sink = &sink;
+      return true;
+    }
+
+    // Queues the reading for every sink; a full queue drops its oldest reading
+    void publish(const SensorReading& reading) {
+      for (int i = 0; i < sinkCount; i++) {
+        OutputSinkState& state = sinks[i];
+        if (state.count == OUTPUT_SINK_QUEUE_LENGTH) {
+          state.head = (state.head + 1) % OUTPUT_SINK_QUEUE_LENGTH;
+          state.count--;
+          state.dropped++;
+        }
+        state.queue[(state.head + state.count) % OUTPUT_SINK_QUEUE_LENGTH] = reading;
+        state.count++;
+      }
+    }
+
+    // Hands at most one batch to each sink per call, so a slow sink only costs its own batch
+    void loop() {
+      unsigned long now = millis();
+      for (int i = 0; i < sinkCount; i++) {
+        OutputSinkState& state = sinks[i];
+        state.sink->loop();
+        if (state.count > 0 && now - state.lastBatchAt >= state.sink->getBatchIntervalMs()) {
+          deliver(state, now);
+        }
+      }
+    }
+
+    int getSinkCount() const {
+      return sinkCount;
+    }
+
+    const OutputSinkState& getState(int index) const {
+      return sinks[index];
+    }
+};
+
+#endif // OUTPUT_SINK_H
@@ -0,0 +1,102 @@
+// SensorState.h
+#ifndef SENSOR_STATE_H
+#define SENSOR_STATE_H
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <type_traits>
+
+/*
+ * Latest readings of every connected sensor, shared between the BLE side that writes them and
+ * the HTTP handlers, history and publishing that read them - possibly from other tasks or cores.
+ *
+ * The table is guarded by one seqlock: a sequence number that is odd while a record is being
+ * written. The writer bumps it around each record update and never waits; a reader copies the
+ * whole table and keeps the copy only if the sequence was even and unchanged throughout, so a
+ * snapshot never pairs a new temperature with an old humidity or catches an address half cleared.
+ * sequence / 2 doubles as the table version: read() returns false without copying anything when
+ * the snapshot already has it, and the HTTP handlers hand it out as an ETag.
+ *
+ * There must be a single writer at a time. All writes come from BLE callbacks and the ownership
+ * check, which run on the loop task; readers may run anywhere.
+ */
+#ifndef MAX_FOUND_PERIPHERALS
+#define MAX_FOUND_PERIPHERALS 10
+#endif
+static const size_t RECORD_ADDRESS_LENGTH = 18; // "aa:bb:cc:dd:ee:ff" + '\0'
+// A write takes microseconds, so a reader that keeps finding one in progress is racing a writer
+// that got preempted; past this many yield()s it sleeps a tick so a lower-priority writer can finish
+static const int SENSOR_STATE_SPIN_RETRIES = 16;
+
+struct SensorRecord {
+  char address[RECORD_ADDRESS_LENGTH]; // empty = free slot
+  float humidity;
+  float temperature;
+  int co2Level;
+  int batteryLevel;
+  int rssi;
+
+  SensorRecord() : address{0}, humidity(NAN), temperature(NAN), co2Level(-1), batteryLevel(-1), rssi(0) {}
+
+  bool isEmpty() const {
+    return address[0] == '\0';
+  }
+};
+
+// Records are copied bytewise while the writer may be active, so they can't own anything
+static_assert(std::is_trivially_copyable<SensorRecord>::value, "SensorRecord must be trivially copyable");
+
+struct SensorSnapshot {
+  SensorRecord records[MAX_FOUND_PERIPHERALS];
+  uint32_t version = 0; // matches the empty table, so the first read() after a write copies
+};
+
+class SensorState {
+private:
+    SensorRecord records[MAX_FOUND_PERIPHERALS];
+    std::atomic<uint32_t> sequence{0};
+
+public:
+    // Writer side: replaces one record
+    void write(int index, const SensorRecord& record) {
+      uint32_t start = sequence.load(std::memory_order_relaxed);
+      sequence.store(start + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release); // odd sequence is visible before the record changes
+      memcpy(&records[index], &record, sizeof(SensorRecord));
+      sequence.store(start + 2, std::memory_order_release);
+    }
+
+    uint32_t getVersion() const {
+      return sequence.load(std::memory_order_acquire) / 2;
+    }
+
+    // Reader side: brings the snapshot up to date, false if it already was
+    bool read(SensorSnapshot& snapshot) const {
+      int spins = 0;
+      while (true) {
+        uint32_t start = sequence.load(std::memory_order_acquire);
+        if (start / 2 == snapshot.version) {
+          return false; // unchanged, or the first write since is still in progress
+        }
+        if ((start & 1) == 0) {
+          memcpy(snapshot.records, records, sizeof(records));
+          std::atomic_thread_fence(std::memory_order_acquire); // copy is done before the sequence is re-read
+          if (sequence.load(std::memory_order_relaxed) == start) {
+            snapshot.version = start / 2;
+            return true;
+          }
+        }
+        // A write is in progress. yield() only gives way to tasks of the same priority - a preempted
+        // lower-priority writer would never get to finish - so fall back to delay(), vTaskDelay(1) on ESP32
+        if (spins < SENSOR_STATE_SPIN_RETRIES) {
+          spins++;
+          yield();
+        } else {
+          delay(1);
+        }
+      }
+    }
+};
+
+#endif // SENSOR_STATE_H
@@ -1,28 +1,78 @@
 #ifndef SENSORS_INFLUXDB_CLIENT_H
-#define SENSORS_INFLUXDB_CLIENT_
+#define SENSORS_INFLUXDB_CLIENT_H
 
 #include <Arduino.h>
 
 #include <InfluxDbClient.h>
 #include <InfluxDbCloud.h>
 
+#include "AllocationTracker.h"
 #include "ExtremelySimpleLogger.h"
+#include "OutputSink.h"
 #include "secrets.h"
 
-class SensorsInfluxDBClient {
+static const char INFLUXDB_MEASUREMENT[] = "sensor_measurement";
+static const size_t INFLUXDB_RECORD_BYTES = 256;
+
+/*
+ * Writes every reading as one line protocol record. The record is formatted into a buffer that
+ * is reused for every write instead of going through Point, whose tags and fields are Strings.
+ */
+class SensorsInfluxDBClient : public OutputSink {
 private:
     InfluxDBClient influxDBClient;
-    Point sensorPoint = Point("sensor_measurement");
+    char gatewayId[32] = {0};
+    char record[INFLUXDB_RECORD_BYTES];
+    size_t length = 0;
+    int fieldCount = 0;
+    bool reachable = false;
+
+    void append(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(record + length, sizeof(record) - length, format, args);
+        va_end(args);
+        length += min((size_t)max(written, 0), sizeof(record) - length - 1);
+    }
+
+    // Commas, spaces and equals signs in tag values are escaped with a backslash
+    void appendTag(const char* name, const char* value) {
+        append(",%s=", name);
+        for (const char* c = value; *c != '\0' && length + 2 < sizeof(record); c++) {
+            if (*c == ',' || *c == ' ' || *c == '=') {
+                record[length++] = '\\';
+            }
+            record[length++] = *c;
+        }
+        record[length] = '\0';
+    }
+
+    void appendField(const char* name, int value) {
+        append("%c%s=%di", fieldCount++ == 0 ? ' ' : ',', name, value);
+    }
+
+    void appendField(const char* name, float value) {
+        if (!isnan(value)) {
+            append("%c%s=%.2f", fieldCount++ == 0 ? ' ' : ',', name, value);
+        }
+    }
 
 public:
     SensorsInfluxDBClient() : influxDBClient(INFLUXDB_URL, INFLUXDB_ORG, INFLUXDB_BUCKET, INFLUXDB_TOKEN, InfluxDbCloud2CACert) {}
 
-    void setup() {
+    void setup(const String &gatewayId) {
+        strncpy(this->gatewayId, gatewayId.c_str(), sizeof(this->gatewayId) - 1);
         influxDBClient.setWriteOptions(WriteOptions().writePrecision(WritePrecision::S));
     }
 
-    bool connect() {
-        if (influxDBClient.validateConnection()) {
+    const char* getName() const override {
+        return "InfluxDB";
+    }
+
+    bool connect() override {
+        ALLOC_ALLOWED(); // validating the connection allocates inside the InfluxDB library
+        reachable = influxDBClient.validateConnection();
+        if (reachable) {
             LOG("Connected to InfluxDB: ");
             LOG_LN(influxDBClient.getServerUrl());
             return true;
@@ -32,35 +82,57 @@ public:
         return false;
     }
 
-    bool writeSensorData(const String &deviceId, const String &location, float temperature, float humidity, int co2, int battery, int rssi) {
-        sensorPoint.clearFields();
-        sensorPoint.clearTags();
+    // Every write is its own HTTP request, so "connected" only means the last one went through
+    bool isConnected() override {
+        return reachable;
+    }
+
+    // Small delay between points to prevent overwhelming the database
+    unsigned long getBatchIntervalMs() const override {
+        return 100;
+    }
+
+    SinkWriteResult write(const SensorReading &reading) override {
+        length = 0;
+        fieldCount = 0;
+        append("%s", INFLUXDB_MEASUREMENT);
 
         // Tags (for grouping/filtering)
-        sensorPoint.addTag("deviceId", deviceId);
-        sensorPoint.addTag("location", location);
+        appendTag("deviceId", reading.deviceId);
+        appendTag("location", reading.location);
+        appendTag("gateway", gatewayId);
 
         // Fields (measurements)
-        if (co2 > 0) {
-            sensorPoint.addField("co2", co2);
+        if (reading.co2 > 0) {
+            appendField("co2", reading.co2);
         } else {
-            sensorPoint.addField("temperature", temperature);
-            sensorPoint.addField("humidity", humidity);
-            sensorPoint.addField("battery", battery);
+            appendField("temperature", reading.temperature);
+            appendField("humidity", reading.humidity);
+            appendField("battery", reading.battery);
         }
-        sensorPoint.addField("rssi", rssi);
+        appendField("rssi", reading.rssi);
 
-        // Timestamp
-        sensorPoint.setTime(time(NULL));
+        // Timestamp of the reading, it may have waited in the queue
+        append(" %lu", (unsigned long)reading.timestamp);
 
-        bool success = influxDBClient.writePoint(sensorPoint);
-        if (success) {
-            LOG_PRINTF("Data written to InfluxDB: %s\n", sensorPoint.toLineProtocol().c_str());
+        int statusCode;
+        {
+            ALLOC_ALLOWED(); // the HTTP request and its error message allocate inside the InfluxDB library
+            if (influxDBClient.writeRecord(record)) {
+                reachable = true;
+                LOG_PRINTF("Data written to InfluxDB: %s\n", record);
+                return SINK_WRITE_OK;
+            }
+            statusCode = influxDBClient.getLastStatusCode();
+            LOG_PRINTF("InfluxDB write failed (%d): %s\n", statusCode, influxDBClient.getLastErrorMessage().c_str());
         }
-        else {
-            LOG_PRINTF("InfluxDB write failed: %s\n", influxDBClient.getLastErrorMessage().c_str());
+        // 4xx means this point will never be accepted (bad data, retention, auth) - except 429, which is back-pressure
+        if (statusCode >= 400 && statusCode < 500 && statusCode != 429) {
+            reachable = true;
+            return SINK_WRITE_REJECTED;
         }
-        return success;
+        reachable = false;
+        return SINK_WRITE_FAILED;
     }
 };
 
@@ -0,0 +1,269 @@
+// SensorsMqttClient.h
+#ifndef SENSORS_MQTT_CLIENT_H
+#define SENSORS_MQTT_CLIENT_H
+
+#include <Arduino.h>
+
+// ESP32 provided libraries
+#include <WiFi.h>
+
+// Internal includes
+#include "AllocationTracker.h"
+#include "ExtremelySimpleLogger.h"
+#include "OutputSink.h"
+#include "secrets.h"
+#ifndef ESP_PLATFORM
+#include <SimulatedMqttSettings.h> // the host simulator always uses its own broker
+#endif
+
+/*
+ * Publishes readings to an MQTT broker (MQTT 3.1.1, QoS 0) over one persistent TCP connection.
+ * Only the packets needed here are implemented: CONNECT/CONNACK, PUBLISH and PINGREQ.
+ * Publishes of a batch are packed into one buffer and written together, so a batch costs a single
+ * TCP segment instead of a request per point; the batch ends when the buffer is full.
+ *
+ * Topic: smarthouse/<gatewayId>/<deviceId>. Payload, CSV by default:
+ *   <timestamp>,<temperature>,<humidity>,<co2>,<battery>,<rssi>
+ * with missing values left empty. Built with -DMQTT_BINARY_PAYLOAD=1 it is a 12 byte little-endian
+ * record instead: uint32 timestamp, int16 temperature * 100, uint16 humidity * 100, uint16 co2,
+ * int8 battery, int8 rssi - INT16_MIN / 0xFFFF / -1 meaning missing.
+ *
+ * smarthouse/<gatewayId>/status is kept at a retained "online", and the broker switches it to
+ * "offline" (last will) when the connection dies.
+ */
+#ifdef MQTT_HOST // the sink only exists when secrets.h names a broker
+
+#ifndef MQTT_PORT
+#define MQTT_PORT 1883
+#endif
+#ifndef MQTT_BINARY_PAYLOAD
+#define MQTT_BINARY_PAYLOAD 0
+#endif
+
+static const char MQTT_TOPIC_PREFIX[] = "smarthouse/";
+static const uint16_t MQTT_KEEP_ALIVE_S = 60;
+static const unsigned long MQTT_CONNECT_TIMEOUT_MS = 3000;
+static const size_t MQTT_BUFFER_BYTES = 1460; // one TCP segment on Ethernet-sized MTUs
+static const size_t MQTT_BATCH_SIZE = 64;
+
+static const uint8_t MQTT_CONNECT = 0x10;
+static const uint8_t MQTT_CONNACK = 0x20;
+static const uint8_t MQTT_PUBLISH = 0x30;
+static const uint8_t MQTT_PUBLISH_RETAIN = 0x01;
+static const uint8_t MQTT_PINGREQ = 0xC0;
+
+class SensorsMqttClient : public OutputSink {
+private:
+    WiFiClient client;
+    char gatewayId[32] = {0};
+    uint8_t buffer[MQTT_BUFFER_BYTES];
+    size_t length = 0;
+    unsigned long lastSent = 0;
+
+    static size_t remainingLengthBytes(size_t remaining) {
+      return remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+    }
+
+    void putByte(uint8_t value) {
+      buffer[length++] = value;
+    }
+
+    void putRemainingLength(size_t remaining) {
+      do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        putByte(remaining > 0 ? digit | 0x80 : digit);
+      } while (remaining > 0);
+    }
+
+    void putString(const char* text, size_t textLength) {
+      putByte(textLength >> 8);
+      putByte(textLength & 0xFF);
+      memcpy(buffer + length, text, textLength);
+      length += textLength;
+    }
+
+    void putString(const char* text) {
+      putString(text, strlen(text));
+    }
+
+    // Topic under smarthouse/<gatewayId>/, written to topic
+    size_t formatTopic(char* topic, size_t size, const char* suffix) const {
+      return snprintf(topic, size, "%s%s/%s", MQTT_TOPIC_PREFIX, gatewayId, suffix);
+    }
+
+    size_t formatPayload(const SensorReading& reading, uint8_t* payload, size_t size) const {
+#if MQTT_BINARY_PAYLOAD
+      int16_t temperature = isnan(reading.temperature) ? INT16_MIN : (int16_t)lroundf(reading.temperature * 100);
+      uint16_t humidity = isnan(reading.humidity) ? 0xFFFF : (uint16_t)lroundf(reading.humidity * 100);
+      uint16_t co2 = reading.co2 < 0 ? 0xFFFF : (uint16_t)reading.co2;
+      uint8_t record[12] = {
+        (uint8_t)reading.timestamp, (uint8_t)(reading.timestamp >> 8), (uint8_t)(reading.timestamp >> 16), (uint8_t)(reading.timestamp >> 24),
+        (uint8_t)temperature, (uint8_t)((uint16_t)temperature >> 8),
+        (uint8_t)humidity, (uint8_t)(humidity >> 8),
+        (uint8_t)co2, (uint8_t)(co2 >> 8),
+        (uint8_t)(int8_t)reading.battery, (uint8_t)(int8_t)reading.rssi
+      };
+      memcpy(payload, record, sizeof(record));
+      return sizeof(record);
+#else
+      char* text = reinterpret_cast<char*>(payload);
+      int written = snprintf(text, size, "%lu,", (unsigned long)reading.timestamp);
+      written += isnan(reading.temperature) ? snprintf(text + written, size - written, ",")
+        : snprintf(text + written, size - written, "%.2f,", reading.temperature);
+      written += isnan(reading.humidity) ? snprintf(text + written, size - written, ",")
+        : snprintf(text + written, size - written, "%.2f,", reading.humidity);
+      written += reading.co2 < 0 ? snprintf(text + written, size - written, ",")
+        : snprintf(text + written, size - written, "%d,", reading.co2);
+      written += reading.battery < 0 ? snprintf(text + written, size - written, ",")
+        : snprintf(text + written, size - written, "%d,", reading.battery);
+      written += snprintf(text + written, size - written, "%d", reading.rssi);
+      return min((size_t)written, size - 1);
+#endif
+    }
+
+    void putPublish(const char* topic, const uint8_t* payload, size_t payloadLength, bool retain) {
+      size_t topicLength = strlen(topic);
+      putByte(MQTT_PUBLISH | (retain ? MQTT_PUBLISH_RETAIN : 0));
+      putRemainingLength(2 + topicLength + payloadLength);
+      putString(topic, topicLength);
+      memcpy(buffer + length, payload, payloadLength);
+      length += payloadLength;
+    }
+
+    bool sendBuffer() {
+      if (length == 0) {
+        return true;
+      }
+      bool sent = client.write(buffer, length) == length;
+      length = 0;
+      if (!sent) {
+        LOG_LN("MQTT write failed, dropping connection");
+        client.stop();
+        return false;
+      }
+      lastSent = millis();
+      return true;
+    }
+
+public:
+    void setup(const String& gatewayId) {
+      strncpy(this->gatewayId, gatewayId.c_str(), sizeof(this->gatewayId) - 1);
+    }
+
+    const char* getName() const override {
+      return "MQTT";
+    }
+
+    bool connect() override {
+      ALLOC_ALLOWED(); // resolving and connecting allocate inside the WiFi library
+      client.stop();
+      length = 0;
+      if (!client.connect(MQTT_HOST, MQTT_PORT)) {
+        LOG_PRINTF("MQTT connection to %s:%d failed\n", (const char*)MQTT_HOST, (int)MQTT_PORT);
+        return false;
+      }
+      client.setNoDelay(true);
+
+      char statusTopic[64];
+      formatTopic(statusTopic, sizeof(statusTopic), "status");
+      const char* username = nullptr;
+      const char* password = nullptr;
+#ifdef MQTT_USERNAME
+      username = MQTT_USERNAME;
+      password = MQTT_PASSWORD;
+#endif
+      uint8_t flags = 0x02 | 0x04 | 0x20; // clean session, will flag, will retain (QoS 0)
+      size_t remaining = 10 + 2 + strlen(gatewayId) + 2 + strlen(statusTopic) + 2 + strlen("offline");
+      if (username != nullptr) {
+        flags |= 0x80 | 0x40;
+        remaining += 2 + strlen(username) + 2 + strlen(password);
+      }
+      putByte(MQTT_CONNECT);
+      putRemainingLength(remaining);
+      putString("MQTT");
+      putByte(4); // protocol level 3.1.1
+      putByte(flags);
+      putByte(MQTT_KEEP_ALIVE_S >> 8);
+      putByte(MQTT_KEEP_ALIVE_S & 0xFF);
+      putString(gatewayId);
+      putString(statusTopic);
+      putString("offline");
+      if (username != nullptr) {
+        putString(username);
+        putString(password);
+      }
+      if (!sendBuffer()) {
+        return false;
+      }
+
+      // CONNACK: 0x20 0x02 <session present> <return code>
+      uint8_t connack[4];
+      size_t received = 0;
+      unsigned long startedAt = millis();
+      while (received < sizeof(connack) && millis() - startedAt < MQTT_CONNECT_TIMEOUT_MS && client.connected()) {
+        int read = client.available() > 0 ? client.read(connack + received, sizeof(connack) - received) : 0;
+        if (read > 0) {
+          received += read;
+        } else {
+          delay(5);
+        }
+      }
+      if (received < sizeof(connack) || connack[0] != MQTT_CONNACK || connack[3] != 0) {
+        LOG_PRINTF("MQTT broker refused connection (return code %d)\n", received == sizeof(connack) ? connack[3] : -1);
+        client.stop();
+        return false;
+      }
+
+      putPublish(statusTopic, reinterpret_cast<const uint8_t*>("online"), strlen("online"), true);
+      if (!sendBuffer()) {
+        return false;
+      }
+      LOG_PRINTF("Connected to MQTT broker %s:%d\n", (const char*)MQTT_HOST, (int)MQTT_PORT);
+      return true;
+    }
+
+    bool isConnected() override {
+      return client.connected();
+    }
+
+    SinkWriteResult write(const SensorReading& reading) override {
+      char topic[64];
+      formatTopic(topic, sizeof(topic), reading.deviceId);
+      uint8_t payload[80];
+      size_t payloadLength = formatPayload(reading, payload, sizeof(payload));
+      size_t packetLength = 1 + remainingLengthBytes(2 + strlen(topic) + payloadLength) + 2 + strlen(topic) + payloadLength;
+      if (length + packetLength > MQTT_BUFFER_BYTES) {
+        return SINK_WRITE_FULL; // sent by flush(), so the batch is dequeued only once it's on the wire
+      }
+      putPublish(topic, payload, payloadLength, false);
+      return SINK_WRITE_OK;
+    }
+
+    bool flush() override {
+      return sendBuffer();
+    }
+
+    void loop() override {
+      if (!client.connected()) {
+        return;
+      }
+      // The only thing the broker sends a QoS 0 publisher is PINGRESP - read and forget
+      while (client.available() > 0) {
+        client.read();
+      }
+      if (millis() - lastSent >= MQTT_KEEP_ALIVE_S * 1000UL / 2) {
+        putByte(MQTT_PINGREQ);
+        putByte(0);
+        sendBuffer();
+      }
+    }
+
+    size_t getBatchSize() const override {
+      return MQTT_BATCH_SIZE;
+    }
+};
+
+#endif // MQTT_HOST
+
+#endif // SENSORS_MQTT_CLIENT_H
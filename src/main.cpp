@@ -11,8 +11,14 @@
 
 // Internal includes
 #include "AddressRoomMap.h"
+#include "AllocationTracker.h"
 #include "ExtremelySimpleLogger.h"
+#include "GatewayCoordinator.h"
+#include "HistoryStore.h"
+#include "OutputSink.h"
+#include "SensorState.h"
 #include "SensorsInfluxDBClient.h"
+#include "SensorsMqttClient.h"
 
 // Credentials and Certificates
 #include "secrets.h"
@@ -20,9 +26,23 @@
 // Start web server on port 80
 WebServer server(80);
 
-// InfluxDB client
+// Output sinks the publish path fans out to: InfluxDB always, MQTT when secrets.h defines MQTT_HOST
+OutputSinks outputSinks;
 SensorsInfluxDBClient sensorsInfluxDBClient;
+#ifdef MQTT_HOST
+SensorsMqttClient sensorsMqttClient;
+#endif
 bool cloudPublishingEnabled = false;
+unsigned long publishRounds = 0; // publish ticks with publishing enabled, for the simulator's soak report
+
+// Coordinates sensor ownership with other gateways on the LAN
+GatewayCoordinator gatewayCoordinator;
+
+// Compressed on-device history for the dashboard sparklines and /api/history
+HistoryStore historyStore;
+static const uint32_t HISTORY_DEFAULT_RANGE_S = 24 * 60 * 60;
+static const uint32_t HISTORY_DEFAULT_POINTS = 240;
+static const size_t HISTORY_CHUNK_BYTES = 1024;
 
 // Define service and characteristic UUIDs as constants
 static const BLEUuid BATTERY_SERVICE_UUID("180F");
@@ -35,23 +55,59 @@ static const BLEUuid SENSIRION_TEMPERATURE_CHARACTERISTIC_UUID("00002235-B38D-49
 static const BLEUuid SENSIRION_SCD4X_CO2_SERVICE_UUID("00007000-B38D-4985-720E-0F993A68EE41");
 static const BLEUuid SENSIRION_SCD4X_CO2_CHARACTERISTIC_UUID("00007001-B38D-4985-720E-0F993A68EE41");
 
+// Owned by the loop task: BLE callbacks update record here, then commitPeripheral() publishes it
 struct SensirionPeripheral {
-  String address;
-  float humidity;
-  float temperature;
-  int co2Level;
-  int batteryLevel;
-  int rssi;
-
-  SensirionPeripheral() : address(""), humidity(NAN), temperature(NAN), co2Level(-1), batteryLevel(-1), rssi(0) {}
+  BLEDevice device;
+  SensorRecord record;
 };
 
-static const int MAX_FOUND_PERIPHERALS = 10;
+// MAX_FOUND_PERIPHERALS (SensorState.h) can be raised from build_flags, e.g. by the soak simulation
+static const int JSON_BYTES_PER_PERIPHERAL = 192;
 SensirionPeripheral knownPeripherals[MAX_FOUND_PERIPHERALS];
 
-int getPeripheralIndexByAddress(const String& address) {
+// Local names the supported sensors advertise, and where to find them in an advertisement
+static const char* const SENSOR_LOCAL_NAMES[] = {"Smart Humigadget", "SHT40 Gadget", "MyCO2"};
+static const int BLE_ADVERTISEMENT_BYTES = 62; // advertising data + scan response, 31 bytes each
+static const uint8_t BLE_AD_SHORT_LOCAL_NAME = 0x08;
+static const uint8_t BLE_AD_COMPLETE_LOCAL_NAME = 0x09;
+
+// Sensors heard advertising, for getAdvertisedAddress(); the oldest entry makes room for a new one
+#ifndef MAX_ADVERTISED_SENSORS
+#define MAX_ADVERTISED_SENSORS MAX_COORDINATED_SENSORS
+#endif
+struct AdvertisedSensor {
+  BLEDevice device;
+  char address[RECORD_ADDRESS_LENGTH];
+
+  AdvertisedSensor() : address{0} {}
+};
+AdvertisedSensor advertisedSensors[MAX_ADVERTISED_SENSORS];
+int nextAdvertisedSensor = 0;
+
+// What everything outside the BLE callbacks reads, each reader through its own snapshot
+SensorState sensorState;
+SensorSnapshot httpSnapshot;
+SensorSnapshot historySnapshot;
+SensorSnapshot publisherSnapshot;
+uint32_t bootId = 0; // keeps ETags of an earlier boot from matching
+
+void commitPeripheral(int index) {
+  sensorState.write(index, knownPeripherals[index].record);
+}
+
+int getPeripheralIndexByAddress(const char* address) {
   for (int i = 0; i < MAX_FOUND_PERIPHERALS; i++) {
-    if (knownPeripherals[i].address == address) {
+    if (strcmp(knownPeripherals[i].record.address, address) == 0) {
+      return i;
+    }
+  }
+  return -1; // Not found
+}
+
+// Allocation free alternative for the notification path - address() builds a String every call
+int getPeripheralIndexByDevice(const BLEDevice& device) {
+  for (int i = 0; i < MAX_FOUND_PERIPHERALS; i++) {
+    if (!knownPeripherals[i].record.isEmpty() && knownPeripherals[i].device == device) {
       return i;
     }
   }
@@ -60,7 +116,7 @@ int getPeripheralIndexByAddress(const String& address) {
 
 int getNextAvailableIndex() {
   for (int i = 0; i < MAX_FOUND_PERIPHERALS; i++) {
-    if (knownPeripherals[i].address == "") {
+    if (knownPeripherals[i].record.isEmpty()) {
       return i;
     }
   }
@@ -68,16 +124,16 @@ int getNextAvailableIndex() {
 }
 
 // Function to handle reading a float characteristic
-void readFloatCharacteristicValue(BLECharacteristic& characteristic, const String& characteristicName, float& store) {
+void readFloatCharacteristicValue(BLECharacteristic& characteristic, const char* characteristicName, float& store) {
     const uint8_t* bytes = characteristic.value();
     uint8_t length = characteristic.valueLength();
     if (length >= 4) {
       float value;
       memcpy(&value, bytes, sizeof(float));
       store = value;
-      LOG_PRINTF("%s: %.2f\n", characteristicName.c_str(), value);
+      LOG_PRINTF("%s: %.2f\n", characteristicName, value);
     } else {
-      LOG_LN("Received data for " + characteristicName + " too short!");
+      LOG_PRINTF("Received data for %s too short!\n", characteristicName);
     }
 }
 
@@ -107,45 +163,111 @@ void readBatteryValue(BLECharacteristic& batteryLevelCharacteristic, int& store)
   }
 }
 
+// Notification handlers run for every sample of every sensor, keep them allocation free
 void onHumidityUpdated(BLEDevice peripheral, BLECharacteristic characteristic) {
-  int index = getPeripheralIndexByAddress(peripheral.address());
-  readFloatCharacteristicValue(characteristic, "Humidity", knownPeripherals[index].humidity);
+  ALLOC_SCOPE(ALLOC_BLE_CALLBACK);
+  int index = getPeripheralIndexByDevice(peripheral);
+  if (index >= 0) {
+    readFloatCharacteristicValue(characteristic, "Humidity", knownPeripherals[index].record.humidity);
+    commitPeripheral(index);
+  }
 }
 
 void onTemperatureUpdated(BLEDevice peripheral, BLECharacteristic characteristic) {
-  int index = getPeripheralIndexByAddress(peripheral.address());
-  readFloatCharacteristicValue(characteristic, "Temperature", knownPeripherals[index].temperature);
+  ALLOC_SCOPE(ALLOC_BLE_CALLBACK);
+  int index = getPeripheralIndexByDevice(peripheral);
+  if (index >= 0) {
+    readFloatCharacteristicValue(characteristic, "Temperature", knownPeripherals[index].record.temperature);
+    commitPeripheral(index);
+  }
 }
 
 void onBatteryUpdated(BLEDevice peripheral, BLECharacteristic characteristic) {
-  int index = getPeripheralIndexByAddress(peripheral.address());
-  readBatteryValue(characteristic, knownPeripherals[index].batteryLevel);
+  ALLOC_SCOPE(ALLOC_BLE_CALLBACK);
+  int index = getPeripheralIndexByDevice(peripheral);
+  if (index >= 0) {
+    readBatteryValue(characteristic, knownPeripherals[index].record.batteryLevel);
+    commitPeripheral(index);
+  }
 }
 
 void onCO2Updated(BLEDevice peripheral, BLECharacteristic characteristic) {
-  int index = getPeripheralIndexByAddress(peripheral.address());
+  ALLOC_SCOPE(ALLOC_BLE_CALLBACK);
+  int index = getPeripheralIndexByDevice(peripheral);
   if (index >= 0) {
-    readCO2Value(characteristic, knownPeripherals[index].co2Level);
+    readCO2Value(characteristic, knownPeripherals[index].record.co2Level);
+    commitPeripheral(index);
   }
 }
 
-void onPeripheralDiscovered(BLEDevice peripheral) {
-  String name = peripheral.localName();
-  if (name == "Smart Humigadget" || name == "SHT40 Gadget" || name == "MyCO2") {
-    BLE.stopScan(); // Stop scanning to let connect to peripheral
-    
-    LOG_LN(name + ": " + peripheral.address());
+// Looks for a supported sensor's local name right in the advertisement bytes - localName() would
+// build a String for every advertisement of every device in range
+const char* getAdvertisedSensorName(BLEDevice& peripheral) {
+  uint8_t data[BLE_ADVERTISEMENT_BYTES];
+  int length = peripheral.advertisementData(data, sizeof(data));
+  // AD structures: length (type + payload), type, payload
+  for (int i = 0; i + 1 < length && data[i] > 0; i += data[i] + 1) {
+    if (data[i + 1] != BLE_AD_SHORT_LOCAL_NAME && data[i + 1] != BLE_AD_COMPLETE_LOCAL_NAME) {
+      continue;
+    }
+    size_t nameLength = min(data[i] - 1, length - i - 2);
+    for (const char* name : SENSOR_LOCAL_NAMES) {
+      if (strlen(name) == nameLength && memcmp(name, data + i + 2, nameLength) == 0) {
+        return name;
+      }
+    }
+    return nullptr;
+  }
+  return nullptr;
+}
 
-    LOG_LN("Opening connection to found peripheral ... ");
-    if (!peripheral.connect()) {
-      LOG_LN("Failed to connect. Resuming scanning.");
-      BLE.scan();
+// address() builds a String, so it's called once per sensor; repeated advertisements are matched
+// with BLEDevice::operator==, which compares the raw address
+const char* getAdvertisedAddress(BLEDevice& peripheral) {
+  for (int i = 0; i < MAX_ADVERTISED_SENSORS; i++) {
+    if (advertisedSensors[i].address[0] != '\0' && advertisedSensors[i].device == peripheral) {
+      return advertisedSensors[i].address;
     }
   }
+  AdvertisedSensor& sensor = advertisedSensors[nextAdvertisedSensor];
+  nextAdvertisedSensor = (nextAdvertisedSensor + 1) % MAX_ADVERTISED_SENSORS;
+  sensor.device = peripheral;
+  {
+    ALLOC_ALLOWED(); // once per sensor heard for the first time, the rest of the scan stays checked
+    strncpy(sensor.address, peripheral.address().c_str(), RECORD_ADDRESS_LENGTH - 1);
+  }
+  sensor.address[RECORD_ADDRESS_LENGTH - 1] = '\0';
+  return sensor.address;
+}
+
+// Scanning reports every advertisement, keep this allocation free until we decide to connect
+void onPeripheralDiscovered(BLEDevice peripheral) {
+  ALLOC_SCOPE(ALLOC_BLE_SCAN);
+  const char* name = getAdvertisedSensorName(peripheral);
+  if (name == nullptr) {
+    return;
+  }
+  const char* address = getAdvertisedAddress(peripheral);
+  gatewayCoordinator.observe(address, peripheral.rssi());
+  if (getPeripheralIndexByAddress(address) >= 0 || getNextAvailableIndex() < 0 || !gatewayCoordinator.shouldOwn(address)) {
+    return; // Already ours, no room for it, or another gateway hears it better
+  }
+  ALLOC_ALLOWED(); // connecting allocates inside ArduinoBLE
+  BLE.stopScan(); // Stop scanning to let connect to peripheral
+
+  LOG_PRINTF("%s: %s\n", name, address);
+
+  LOG_LN("Opening connection to found peripheral ... ");
+  if (!peripheral.connect()) {
+    LOG_LN("Failed to connect. Resuming scanning.");
+    BLE.scan(true);
+  }
 }
 
 void onPeripheralConnected(BLEDevice peripheral) {
-  int index = getPeripheralIndexByAddress(peripheral.address());
+  ALLOC_SCOPE(ALLOC_BLE_SCAN);
+  ALLOC_ALLOWED(); // attribute discovery allocates inside ArduinoBLE
+  int index = getPeripheralIndexByAddress(peripheral.address().c_str());
   if (index < 0) { // Not found, get next available index
     index = getNextAvailableIndex();
     if (index < 0) { // No available index
@@ -153,7 +275,9 @@ void onPeripheralConnected(BLEDevice peripheral) {
       return;
     }
   }
-  knownPeripherals[index].address = peripheral.address();
+  knownPeripherals[index].device = peripheral;
+  strncpy(knownPeripherals[index].record.address, peripheral.address().c_str(), RECORD_ADDRESS_LENGTH - 1);
+  gatewayCoordinator.setOwned(knownPeripherals[index].record.address, true);
 
   LOG_LN("Connected. Discovering attributes ...");
   if (!peripheral.discoverAttributes()) {
@@ -180,7 +304,7 @@ void onPeripheralConnected(BLEDevice peripheral) {
   BLECharacteristic batteryLevelCharacteristic = batteryService.characteristic(BATTERY_LEVEL_CHARACTERISTIC_UUID.str());
   if (batteryLevelCharacteristic.canRead()) {  // we're reading to get initial battery level value since updates are very rare
     batteryLevelCharacteristic.read();
-    readBatteryValue(batteryLevelCharacteristic, knownPeripherals[index].batteryLevel);
+    readBatteryValue(batteryLevelCharacteristic, knownPeripherals[index].record.batteryLevel);
   }
   if (batteryLevelCharacteristic.canSubscribe()) {
     batteryLevelCharacteristic.setEventHandler(BLEUpdated, onBatteryUpdated);
@@ -195,34 +319,93 @@ void onPeripheralConnected(BLEDevice peripheral) {
     scd4xCO2LevelCharacteristic.subscribe();
   }    
 
-  knownPeripherals[index].rssi = peripheral.rssi();
+  knownPeripherals[index].record.rssi = peripheral.rssi();
+  commitPeripheral(index);
 
-  // Once connected start scanning again
-  BLE.scan();
+  // Once connected start scanning again, reporting every advertisement so RSSI of other sensors stays fresh
+  BLE.scan(true);
 }
 
 void onPeripheralDisconnected(BLEDevice peripheral) {
-  LOG_PRINTF("Disconnected from peripheral: %s\n", peripheral.address().c_str());
-  int index = getPeripheralIndexByAddress(peripheral.address());
-  knownPeripherals[index] = SensirionPeripheral();
+  ALLOC_SCOPE(ALLOC_BLE_SCAN);
+  // Matched by device rather than address(), which would build a String
+  int index = getPeripheralIndexByDevice(peripheral);
+  if (index >= 0) {
+    LOG_PRINTF("Disconnected from peripheral: %s\n", knownPeripherals[index].record.address);
+    gatewayCoordinator.setOwned(knownPeripherals[index].record.address, false);
+    knownPeripherals[index] = SensirionPeripheral();
+    commitPeripheral(index);
+  }
   // Never stopped scanning so no need to call BLE.scan() again
 }
 
+// Refresh RSSI of connected sensors and hand over the ones another gateway now hears better
+void rebalanceSensorOwnership() {
+  ALLOC_SCOPE(ALLOC_COORDINATOR);
+  for (int i = 0; i < MAX_FOUND_PERIPHERALS; i++) {
+    SensorRecord& record = knownPeripherals[i].record;
+    if (record.isEmpty()) {
+      continue;
+    }
+    int rssi = knownPeripherals[i].device.rssi();
+    if (rssi != record.rssi) { // an unchanged table keeps its version, so readers can skip it
+      record.rssi = rssi;
+      commitPeripheral(i);
+    }
+    gatewayCoordinator.observe(record.address, record.rssi);
+    if (!gatewayCoordinator.shouldOwn(record.address)) {
+      LOG_PRINTF("Handing over %s to another gateway\n", record.address);
+      knownPeripherals[i].device.disconnect();
+    }
+  }
+}
+
+String getGatewayId() {
+#ifdef GATEWAY_ID
+  return GATEWAY_ID;
+#else
+  // Last three bytes of the MAC are unique enough within one house
+  String mac = WiFi.macAddress();
+  mac.replace(":", "");
+  mac.toLowerCase();
+  return "gw-" + mac.substring(6);
+#endif
+}
+
+// Tags the response with the snapshot's version, or answers 304 when the client already has it
+bool respondNotModified(const SensorSnapshot& snapshot) {
+  char etag[24];
+  snprintf(etag, sizeof(etag), "\"%08lx-%lx\"", (unsigned long)bootId, (unsigned long)snapshot.version);
+  if (server.header("If-None-Match") == etag) {
+    server.send(304);
+    return true;
+  }
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "no-cache"); // revalidate every time, it's cheap
+  return false;
+}
+
 // HTTP handler
 void handleRoot() {
-  StaticJsonDocument<1024> respJsonDoc;
+  ALLOC_ALLOWED(); // serving the request
+  sensorState.read(httpSnapshot);
+  if (respondNotModified(httpSnapshot)) {
+    return;
+  }
+  DynamicJsonDocument respJsonDoc(JSON_BYTES_PER_PERIPHERAL * MAX_FOUND_PERIPHERALS);
   JsonArray array = respJsonDoc.to<JsonArray>();
   for (int i = 0; i < MAX_FOUND_PERIPHERALS; i++) {
-    if (knownPeripherals[i].address == "") { 
+    const SensorRecord& record = httpSnapshot.records[i];
+    if (record.isEmpty()) { 
       continue; // Skip empty entries 
     }
     JsonObject responseObj = array.createNestedObject();
-    responseObj["address"] = knownPeripherals[i].address;
-    responseObj["humidity"] = isnan(knownPeripherals[i].humidity) ? "null" : String(knownPeripherals[i].humidity, 2);
-    responseObj["temperature"] = isnan(knownPeripherals[i].temperature) ? "null" : String(knownPeripherals[i].temperature, 2);
-    responseObj["co2"] = (knownPeripherals[i].co2Level < 0) ? "null" : String(knownPeripherals[i].co2Level);
-    responseObj["battery"] = (knownPeripherals[i].batteryLevel < 0) ? "null" : String(knownPeripherals[i].batteryLevel);
-    responseObj["rssi"] = knownPeripherals[i].rssi;
+    responseObj["address"] = record.address;
+    responseObj["humidity"] = isnan(record.humidity) ? "null" : String(record.humidity, 2);
+    responseObj["temperature"] = isnan(record.temperature) ? "null" : String(record.temperature, 2);
+    responseObj["co2"] = (record.co2Level < 0) ? "null" : String(record.co2Level);
+    responseObj["battery"] = (record.batteryLevel < 0) ? "null" : String(record.batteryLevel);
+    responseObj["rssi"] = record.rssi;
   }
 
   String jsonString;
@@ -232,6 +415,7 @@ void handleRoot() {
 
 // Handle toggle cloud publishing
 void handleToggleCloud() {
+  ALLOC_ALLOWED(); // serving the request
   if (server.hasArg("enabled")) {
     String state = server.arg("enabled");
     cloudPublishingEnabled = (state == "true" || state == "1");
@@ -244,6 +428,11 @@ void handleToggleCloud() {
 
 // Better dashboard
 void handleDashboard() {
+  ALLOC_ALLOWED(); // serving the request
+  sensorState.read(httpSnapshot);
+  if (respondNotModified(httpSnapshot)) {
+    return;
+  }
   String html = R"rawliteral(
     <!DOCTYPE html>
     <html>
@@ -263,6 +452,8 @@ void handleDashboard() {
         }
         .value { font-size: 2em; }
         .addr { font-size: 0.8em; color: #888; }
+        .spark { display: block; margin: 4px auto 0; width: 160px; height: 32px; }
+        .spark polyline { fill: none; stroke: #4CAF50; stroke-width: 1.5; }
         button#cloudBtn {
           padding: 12px 24px;
           font-size: 16px;
@@ -296,25 +487,32 @@ void handleDashboard() {
     <body>
       <h2>Humidity & Temperature Dashboard</h2>
   )rawliteral";
+  html += "<div class='addr'>Gateway: " + String(gatewayCoordinator.getGatewayId()) + "</div>";
   for (int i = 0; i < MAX_FOUND_PERIPHERALS; i++) {
-    if (knownPeripherals[i].address != "") {
-      html += "<div class='tile'>";
-      html += "<div><b>" + getRoomNameByAddress(knownPeripherals[i].address) + "</b></div>";
-      html += "<div class='addr'>" + knownPeripherals[i].address + "</div>";
+    const SensorRecord& record = httpSnapshot.records[i];
+    if (!record.isEmpty()) {
+      String address = record.address;
+      html += "<div class='tile' data-device='" + address + "'>";
+      html += "<div><b>" + String(getRoomNameByAddress(record.address)) + "</b></div>";
+      html += "<div class='addr'>" + address + "</div>";
       html += "<div>Humidity: <span class='value'>";
-      html += isnan(knownPeripherals[i].humidity) ? "N/A" : String(knownPeripherals[i].humidity, 1);
-      html += " %</span></div>";
+      html += isnan(record.humidity) ? "N/A" : String(record.humidity, 1);
+      html += " %</span><svg class='spark' data-series='humidity'></svg></div>";
       html += "<div>Temperature: <span class='value'>";
-      html += isnan(knownPeripherals[i].temperature) ? "N/A" : String(knownPeripherals[i].temperature, 1);
-      html += " &deg;C</span></div>";
+      html += isnan(record.temperature) ? "N/A" : String(record.temperature, 1);
+      html += " &deg;C</span><svg class='spark' data-series='temperature'></svg></div>";
       html += "<div>CO2: <span class='value'>";
-      html += (knownPeripherals[i].co2Level < 0) ? "N/A" : String(knownPeripherals[i].co2Level) + " ppm";
-      html += "</span></div>";
+      html += (record.co2Level < 0) ? "N/A" : String(record.co2Level) + " ppm";
+      html += "</span>";
+      if (record.co2Level >= 0) {
+        html += "<svg class='spark' data-series='co2'></svg>";
+      }
+      html += "</div>";
       html += "<div>Battery: <span class='value'>";
-      html += (knownPeripherals[i].batteryLevel < 0) ? "N/A" : String(knownPeripherals[i].batteryLevel) + " %";
+      html += (record.batteryLevel < 0) ? "N/A" : String(record.batteryLevel) + " %";
       html += "</span></div>";
       html += "<div>RSSI: <span class='value'>";
-      html += String(knownPeripherals[i].rssi) + " dBm";
+      html += String(record.rssi) + " dBm";
       html += "</span></div>";
       html += "</div>";
     }
@@ -338,6 +536,27 @@ void handleDashboard() {
             btn.className = isEnabled ? 'on' : 'off';
           });
       }
+      // Last 24 hours from the gateway's own history, one request per sensor
+      document.querySelectorAll('.tile[data-device]').forEach(tile => {
+        fetch('/api/history?device=' + tile.dataset.device + '&from=-86400&step=900')
+          .then(response => response.json())
+          .then(data => {
+            tile.querySelectorAll('.spark').forEach(svg => {
+              const points = data[svg.dataset.series] || [];
+              if (points.length < 2) {
+                return;
+              }
+              const values = points.map(p => p[1]);
+              const low = Math.min(...values), high = Math.max(...values);
+              const range = (high - low) || 1;
+              svg.setAttribute('viewBox', '0 0 160 32');
+              svg.innerHTML = "<polyline points='" + points.map((p, i) =>
+                (i * 160 / (points.length - 1)).toFixed(1) + ',' + (30 - (p[1] - low) * 28 / range).toFixed(1)).join(' ') + "'/>";
+              svg.innerHTML += '<title>' + low.toFixed(1) + ' - ' + high.toFixed(1) + '</title>';
+            });
+          })
+          .catch(() => {});
+      });
       // Update button state on load
       fetch('/api/cloud')
         .then(response => response.json())
@@ -356,22 +575,218 @@ void handleDashboard() {
   server.send(200, "text/html", html);
 }
 
-void writeSensorDataToInfluxDB() {
+// Sample current readings into the on-device history
+void recordHistory() {
+  time_t now = time(nullptr);
+  if (now < HISTORY_MIN_VALID_TIME) {
+    return; // no NTP time yet
+  }
+  // Sampled every interval even when nothing changed - the snapshot is only re-copied when it did
+  sensorState.read(historySnapshot);
+  for (int i = 0; i < MAX_FOUND_PERIPHERALS; i++) {
+    const SensorRecord& record = historySnapshot.records[i];
+    if (record.isEmpty()) {
+      continue;
+    }
+    historyStore.record(record.address, HISTORY_TEMPERATURE, record.temperature, now);
+    historyStore.record(record.address, HISTORY_HUMIDITY, record.humidity, now);
+    if (record.co2Level >= 0) {
+      historyStore.record(record.address, HISTORY_CO2, record.co2Level, now);
+    }
+  }
+}
+
+// Appends to the chunk buffer, first sending it as a chunk of the response when the text doesn't fit
+void appendHistoryChunk(char* chunk, size_t& length, const char* format, ...) {
+  while (true) {
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(chunk + length, HISTORY_CHUNK_BYTES - length, format, args);
+    va_end(args);
+    if (written < 0) {
+      chunk[length] = '\0';
+      return;
+    }
+    if ((size_t)written < HISTORY_CHUNK_BYTES - length) {
+      length += written;
+      return;
+    }
+    if (length == 0) {
+      length = HISTORY_CHUNK_BYTES - 1; // longer than a whole chunk, send what fit
+      return;
+    }
+    server.sendContent(chunk, length);
+    length = 0;
+  }
+}
+
+// Parses from/to: epoch seconds, or seconds relative to now when negative
+uint32_t parseHistoryTime(const String& value, uint32_t now) {
+  long parsed = value.toInt();
+  return parsed < 0 ? now - min((uint32_t)-parsed, now) : (uint32_t)parsed;
+}
+
+// /api/history?device=<address>&from=<s>&to=<s>&step=<s> - streamed, downsampled to [start, avg, min, max] per step
+void handleHistory() {
+  ALLOC_ALLOWED(); // serving the request
+  int sensor = historyStore.findSensor(server.arg("device").c_str());
+  if (sensor < 0) {
+    server.send(404, "application/json", "{\"error\": \"no history for device\"}");
+    return;
+  }
+  uint32_t now = time(nullptr);
+  uint32_t to = server.hasArg("to") ? parseHistoryTime(server.arg("to"), now) : now;
+  uint32_t from = server.hasArg("from") ? parseHistoryTime(server.arg("from"), now) : to - min(HISTORY_DEFAULT_RANGE_S, to);
+  long requestedStep = server.hasArg("step") ? server.arg("step").toInt() : 0;
+  if (from > to) {
+    server.send(400, "application/json", "{\"error\": \"from is after to\"}");
+    return;
+  }
+  if (server.hasArg("step") && requestedStep <= 0) {
+    server.send(400, "application/json", "{\"error\": \"step must be a positive number of seconds\"}");
+    return;
+  }
+  uint32_t step = requestedStep;
+  if (step == 0) {
+    step = max(HISTORY_SAMPLE_INTERVAL_S, (to - from) / HISTORY_DEFAULT_POINTS);
+  }
+
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  char chunk[HISTORY_CHUNK_BYTES];
+  size_t length = 0;
+  appendHistoryChunk(chunk, length, "{\"device\":\"%s\",\"from\":%lu,\"to\":%lu,\"step\":%lu",
+    server.arg("device").c_str(), (unsigned long)from, (unsigned long)to, (unsigned long)step);
+  for (int q = 0; q < HISTORY_QUANTITY_COUNT; q++) {
+    appendHistoryChunk(chunk, length, ",\"%s\":[", HISTORY_QUANTITY_NAMES[q]);
+    HistoryCursor cursor = historyStore.cursor(sensor, static_cast<HistoryQuantity>(q), from, to);
+    HistoryDownsampler downsampler(cursor, from, step);
+    HistoryBucket bucket;
+    bool first = true;
+    while (downsampler.next(bucket)) {
+      appendHistoryChunk(chunk, length, "%s[%lu,%.2f,%.2f,%.2f]", first ? "" : ",",
+        (unsigned long)bucket.start, bucket.average, bucket.minimum, bucket.maximum);
+      first = false;
+    }
+    appendHistoryChunk(chunk, length, "]");
+  }
+  appendHistoryChunk(chunk, length, "}");
+  server.sendContent(chunk, length);
+  server.sendContent("");
+}
+
+// Queue one reading per peripheral for every sink; OutputSinks::loop() delivers them
+void publishSensorData() {
+  ALLOC_SCOPE(ALLOC_PUBLISHER);
   // Skip if cloud publishing is disabled
   if (!cloudPublishingEnabled) {
     return;
   }
-  // Process each peripheral individually
+  publishRounds++;
+  uint32_t now = time(nullptr);
+  sensorState.read(publisherSnapshot);
   for (int i = 0; i < MAX_FOUND_PERIPHERALS; i++) {
-    if (knownPeripherals[i].address != "") {
-      sensorsInfluxDBClient.writeSensorData(knownPeripherals[i].address, getRoomNameByAddress(knownPeripherals[i].address), knownPeripherals[i].temperature, knownPeripherals[i].humidity, knownPeripherals[i].co2Level, knownPeripherals[i].batteryLevel, knownPeripherals[i].rssi);
+    const SensorRecord& record = publisherSnapshot.records[i];
+    if (!record.isEmpty()) {
+      SensorReading reading;
+      strncpy(reading.deviceId, record.address, sizeof(reading.deviceId) - 1);
+      strncpy(reading.location, getRoomNameByAddress(record.address), sizeof(reading.location) - 1);
+      reading.temperature = record.temperature;
+      reading.humidity = record.humidity;
+      reading.co2 = record.co2Level;
+      reading.battery = record.batteryLevel;
+      reading.rssi = record.rssi;
+      reading.timestamp = now;
+      outputSinks.publish(reading);
+    }
+  }
+}
 
-      // Small delay to prevent overwhelming the database
-      delay(100);
+// Readings queued for the InfluxDB sink, those it dropped (full queue or refused by the server) and those it still holds,
+// for the simulator's soak report
+void getInfluxDBSinkBacklog(unsigned long& published, unsigned long& dropped, unsigned long& queued) {
+  published = 0;
+  dropped = 0;
+  queued = 0;
+  for (int i = 0; i < outputSinks.getSinkCount(); i++) {
+    const OutputSinkState& state = outputSinks.getState(i);
+    if (state.sink == &sensorsInfluxDBClient) {
+      // Every reading that entered the queue has left it one of these ways or is still in it
+      published = state.delivered + state.dropped + state.rejected + state.count;
+      dropped = state.dropped + state.rejected;
+      queued = state.count;
     }
   }
 }
 
+void handleNotFound() {
+  ALLOC_ALLOWED(); // serving the request
+  server.send(404, "text/plain", "Not found: " + server.uri());
+}
+
+// Queue and health of every output sink
+void handleSinks() {
+  ALLOC_ALLOWED(); // serving the request
+  DynamicJsonDocument respJsonDoc(256 * MAX_OUTPUT_SINKS);
+  JsonArray array = respJsonDoc.to<JsonArray>();
+  for (int i = 0; i < outputSinks.getSinkCount(); i++) {
+    const OutputSinkState& state = outputSinks.getState(i);
+    JsonObject sink = array.createNestedObject();
+    sink["name"] = state.sink->getName();
+    sink["connected"] = state.sink->isConnected();
+    sink["queued"] = (unsigned long)state.count;
+    sink["delivered"] = state.delivered;
+    sink["dropped"] = state.dropped;
+    sink["rejected"] = state.rejected;
+    sink["failures"] = state.failures;
+  }
+
+  String jsonString;
+  serializeJsonPretty(array, jsonString);
+  server.send(200, "application/json", jsonString);
+}
+
+#if ALLOC_TRACKING
+// Allocation counters per subsystem and per call site
+void handleAllocations() {
+  ALLOC_ALLOWED(); // serving the request
+  DynamicJsonDocument respJsonDoc(4096);
+  JsonObject subsystems = respJsonDoc.createNestedObject("subsystems");
+  for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+    JsonObject subsystem = subsystems.createNestedObject(ALLOCATION_SUBSYSTEM_NAMES[i]);
+    subsystem["allocations"] = allocationTracker.subsystems[i].count;
+    subsystem["bytes"] = allocationTracker.subsystems[i].bytes;
+  }
+  JsonObject otherTasks = subsystems.createNestedObject("otherTasks");
+  otherTasks["allocations"] = allocationTracker.otherTasks.count;
+  otherTasks["bytes"] = allocationTracker.otherTasks.bytes;
+  JsonArray sites = respJsonDoc.createNestedArray("sites");
+  char caller[64];
+  for (int i = 0; i < MAX_ALLOCATION_SITES && allocationTracker.sites[i].caller != nullptr; i++) {
+    JsonObject site = sites.createNestedObject();
+    AllocationTracker::formatAllocationCaller(allocationTracker.sites[i].caller, caller, sizeof(caller));
+    site["caller"] = caller; // copied, the buffer is reused
+    site["scope"] = allocationTracker.sites[i].scope != nullptr ? allocationTracker.sites[i].scope : "loop()";
+    site["subsystem"] = ALLOCATION_SUBSYSTEM_NAMES[allocationTracker.sites[i].subsystem];
+    site["allocations"] = allocationTracker.sites[i].counter.count;
+    site["bytes"] = allocationTracker.sites[i].counter.bytes;
+  }
+  respJsonDoc["frees"] = allocationTracker.frees;
+  respJsonDoc["loopCycles"] = allocationTracker.loopCycles;
+  respJsonDoc["allowedAllocations"] = allocationTracker.allowedAllocations;
+  respJsonDoc["steadyStateViolations"] = allocationTracker.steadyStateViolations;
+  if (allocationTracker.lastViolationCaller != nullptr) {
+    AllocationTracker::formatAllocationCaller(allocationTracker.lastViolationCaller, caller, sizeof(caller));
+    respJsonDoc["lastViolationCaller"] = caller;
+    respJsonDoc["lastViolationScope"] = allocationTracker.lastViolationScope != nullptr ? allocationTracker.lastViolationScope : "loop()";
+  }
+
+  String jsonString;
+  serializeJsonPretty(respJsonDoc, jsonString);
+  server.send(200, "application/json", jsonString);
+}
+#endif
+
 #if MEMORY_DEBUG
 void printMemoryInfo() {
   Serial.println();
@@ -383,6 +798,7 @@ void printMemoryInfo() {
   Serial.printf("Flash size: %d bytes\n", ESP.getFlashChipSize());
   Serial.printf("Sketch size: %d bytes\n", ESP.getSketchSize());
   Serial.printf("Free sketch space: %d bytes\n", ESP.getFreeSketchSpace());
+  Serial.printf("History blocks: %d/%d used\n", historyStore.getUsedBlocks(), historyStore.getBlockCount());
   Serial.println("===================");
   Serial.println();
 }
@@ -391,10 +807,15 @@ void printMemoryInfo() {
 void setup() {
   Serial.begin(115200);
 
+  #if ALLOC_TRACKING
+  allocationTracker.begin();
+  #endif
+
   // Initialize foundPeripherals array
   for (int i = 0; i < MAX_FOUND_PERIPHERALS; i++) {
     knownPeripherals[i] = SensirionPeripheral();
   }
+  bootId = esp_random();
 
   // Connect to WiFi
   WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
@@ -408,14 +829,35 @@ void setup() {
   // Set NTP details UTC time only
   configTime(0, 0, "pool.ntp.org", "europe.pool.ntp.org");
 
-  // Setup InfluxDB Client
-  sensorsInfluxDBClient.setup();
+  // Join other gateways on the LAN
+  String gatewayId = getGatewayId();
+  gatewayCoordinator.setup(gatewayId);
+  Serial.println("Gateway ID: " + gatewayId);
+
+  // History arena lives in PSRAM, allocate it once up front
+  historyStore.setup();
+
+  // Setup output sinks
+  sensorsInfluxDBClient.setup(gatewayId);
   sensorsInfluxDBClient.connect();
+  outputSinks.add(sensorsInfluxDBClient);
+  #ifdef MQTT_HOST
+  sensorsMqttClient.setup(gatewayId);
+  outputSinks.add(sensorsMqttClient);
+  #endif
 
   // HTTP server setup
   server.on("/", handleRoot);
   server.on("/dashboard", handleDashboard);
   server.on("/api/cloud", handleToggleCloud);
+  server.on("/api/history", handleHistory);
+  server.on("/api/sinks", handleSinks);
+  server.onNotFound(handleNotFound);
+  static const char* collectedHeaders[] = {"If-None-Match"};
+  server.collectHeaders(collectedHeaders, 1);
+  #if ALLOC_TRACKING
+  server.on("/api/allocations", handleAllocations);
+  #endif
   server.begin();
   Serial.println("HTTP server started");
 
@@ -426,7 +868,7 @@ void setup() {
   BLE.setEventHandler(BLEConnected, onPeripheralConnected);
   BLE.setEventHandler(BLEDisconnected, onPeripheralDisconnected);
   // start scanning for peripherals
-  BLE.scan();
+  BLE.scan(true);
 
   #if MEMORY_DEBUG
   printMemoryInfo();
@@ -436,23 +878,58 @@ void setup() {
 // Timer variables for periodic publishing
 unsigned long previousMillis = 0;
 const long publishInterval = 60000; // Publish every 60 seconds
+unsigned long previousOwnershipCheckMillis = 0;
+unsigned long previousHistoryMillis = 0;
 
 void loop() {
-  BLE.poll(); // poll for events
-  server.handleClient(); // handle HTTP requests
+  ALLOC_LOOP_CYCLE(); // in steady state nothing below may allocate outside an ALLOC_ALLOWED() library call
+
+  {
+    ALLOC_SCOPE(ALLOC_BLE_CALLBACK);
+    BLE.poll(); // poll for events
+  }
+  {
+    ALLOC_SCOPE(ALLOC_HTTP_HANDLER);
+    ALLOC_ALLOWED_IF_SERVED(); // parsing and answering a request allocates, an idle poll must not
+    server.handleClient(); // handle HTTP requests
+  }
+  {
+    ALLOC_SCOPE(ALLOC_COORDINATOR);
+    gatewayCoordinator.loop(); // exchange announcements with other gateways
+  }
+
+  // Re-evaluate sensor ownership as often as gateways announce
+  if (millis() - previousOwnershipCheckMillis >= GATEWAY_ANNOUNCE_INTERVAL_MS) {
+    previousOwnershipCheckMillis = millis();
+    rebalanceSensorOwnership();
+  }
   
+  // Sample history on a fixed interval - it's what keeps the timestamps at one bit each
+  if (millis() - previousHistoryMillis >= HISTORY_SAMPLE_INTERVAL_MS) {
+    previousHistoryMillis = millis();
+    recordHistory();
+  }
+
   // Publish data periodically
   unsigned long currentMillis = millis();
   if (currentMillis - previousMillis >= publishInterval) {
     previousMillis = currentMillis;
-    writeSensorDataToInfluxDB();
+    publishSensorData();
+  }
+  {
+    ALLOC_SCOPE(ALLOC_PUBLISHER);
+    outputSinks.loop(); // each sink drains its own queue
   }
 
   #if MEMORY_DEBUG
   static unsigned long lastMemCheck = 0;
   if (millis() - lastMemCheck > 30000) {
+    ALLOC_ALLOWED(); // diagnostics - Serial.printf allocates for long lines
     lastMemCheck = millis();
     printMemoryInfo();
+    #if ALLOC_TRACKING
+    printAllocationInfo();
+    #endif
   }
   #endif
 }
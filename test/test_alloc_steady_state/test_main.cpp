@@ -0,0 +1,112 @@
+// Steady-state guarantee of AllocationTracker: the whole firmware runs against the simulated radio,
+// the mock InfluxDB and the mock MQTT broker while a client polls the HTTP API, and once
+// ALLOC_WARMUP_MS has passed no loop() cycle may allocate outside the library calls that serve a
+// request or (re)connect something. Only built by native_alloc
+#include <Arduino.h>
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "MockInfluxDB.h"
+#include "MockMqttBroker.h"
+#include "SimulationConfig.h"
+#include "SoakStatistics.h"
+
+// Provided by the firmware
+void setup();
+void loop();
+extern bool cloudPublishingEnabled;
+extern unsigned long publishRounds;
+extern "C" unsigned long allocationTrackerSteadyStateViolations();
+
+static const int INFLUX_PORT = 18287;
+static const int MQTT_PORT = 18288;
+static const int HTTP_PORT = 18289;
+static const unsigned long STEP_MS = 50;
+static const unsigned long PUBLISH_ROUNDS = 5;
+
+static std::atomic<bool> polling{false};
+static std::atomic<bool> clientDone{false};
+static std::atomic<int> responses{0};
+
+// Fetches a few pages in turn, one connection each, from a thread of its own - the firmware serves them in loop()
+static void pollHttpApi() {
+    const char* paths[] = {"/", "/api/sinks", "/dashboard", "/api/history?device=c0:de:00:00:00:01&from=-3600", "/missing"};
+    const int pathCount = sizeof(paths) / sizeof(paths[0]);
+    for (int i = 0; polling; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in server = {};
+        server.sin_family = AF_INET;
+        server.sin_port = htons(HTTP_PORT);
+        server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&server), sizeof(server)) == 0) {
+            char request[128];
+            int length = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: gateway\r\n\r\n", paths[i % pathCount]);
+            send(fd, request, length, 0);
+            char response[4096];
+            if (recv(fd, response, sizeof(response), 0) > 0) {
+                responses++;
+            }
+        }
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    clientDone = true;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_steady_state_loop_does_not_allocate() {
+    simulationConfig.seed = 28;
+    simulationConfig.sensorCount = 12;
+    simulationConfig.httpPort = HTTP_PORT;
+    simulationConfig.notifyIntervalMs = 500;
+    TEST_ASSERT_TRUE(mockInfluxDB.begin(INFLUX_PORT));
+    TEST_ASSERT_TRUE(mockMqttBroker.begin(MQTT_PORT, 0));
+    char url[32];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d", INFLUX_PORT);
+    setenv("SIM_INFLUXDB_URL", url, 1);
+    char port[8];
+    snprintf(port, sizeof(port), "%d", MQTT_PORT);
+    setenv("SIM_MQTT_HOST", "127.0.0.1", 1);
+    setenv("SIM_MQTT_PORT", port, 1);
+
+    setup();
+    cloudPublishingEnabled = true;
+    polling = true;
+    std::thread client(pollHttpApi);
+    // Simulated time runs ahead in steps, the short sleep gives the other threads their turn
+    while (millis() < ALLOC_WARMUP_MS || publishRounds < PUBLISH_ROUNDS) {
+        loop();
+        advanceMillis(STEP_MS);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    polling = false;
+    while (!clientDone) {
+        loop(); // answers the request the client may still be waiting on
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    client.join();
+    mockInfluxDB.stop();
+    mockMqttBroker.stop();
+
+    // Make sure the run exercised the publish and request paths at all
+    TEST_ASSERT_TRUE(responses > 0);
+    TEST_ASSERT_TRUE(soakStatistics.notificationsSent > 0);
+    TEST_ASSERT_TRUE(soakStatistics.pointsAccepted > 0);
+    TEST_ASSERT_TRUE(soakStatistics.mqttAccepted > 0);
+    TEST_ASSERT_EQUAL(0, allocationTrackerSteadyStateViolations());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_state_loop_does_not_allocate);
+    return UNITY_END();
+}
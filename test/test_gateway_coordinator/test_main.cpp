@@ -0,0 +1,129 @@
+// Ownership, timeout and tie-break rules of GatewayCoordinator, with announcements fed in directly
+// and millis() moved forward by advanceMillis() instead of waiting
+#include <Arduino.h>
+#include <unity.h>
+
+#include "GatewayCoordinator.h"
+
+static const char SENSOR[] = "c0:de:00:00:00:01";
+
+static GatewayCoordinator* coordinator = nullptr;
+
+static void announce(const char* gatewayId, int rssi, bool owned) {
+    char announcement[96];
+    snprintf(announcement, sizeof(announcement), "%s %s\n%s %d %d\n", GATEWAY_PACKET_HEADER, gatewayId, SENSOR, rssi, owned ? 1 : 0);
+    coordinator->receive(announcement);
+}
+
+// Past the start-up grace period, during which nothing is claimed
+static void startUp() {
+    advanceMillis(2 * GATEWAY_ANNOUNCE_INTERVAL_MS);
+}
+
+void setUp() {
+    coordinator = new GatewayCoordinator();
+    coordinator->setup("gw-b");
+}
+
+void tearDown() {
+    delete coordinator;
+    coordinator = nullptr;
+}
+
+void test_waits_for_other_gateways_after_start() {
+    coordinator->observe(SENSOR, -60);
+    TEST_ASSERT_FALSE(coordinator->shouldOwn(SENSOR));
+    startUp();
+    coordinator->observe(SENSOR, -60);
+    TEST_ASSERT_TRUE(coordinator->shouldOwn(SENSOR));
+}
+
+void test_unknown_or_unheard_sensor_is_not_claimed() {
+    startUp();
+    TEST_ASSERT_FALSE(coordinator->shouldOwn(SENSOR));
+    coordinator->observe(SENSOR, -60);
+    advanceMillis(OBSERVATION_TTL_MS);
+    TEST_ASSERT_FALSE(coordinator->shouldOwn(SENSOR));
+}
+
+void test_unowned_sensor_goes_to_strongest_gateway() {
+    startUp();
+    coordinator->observe(SENSOR, -60);
+    announce("gw-c", -55, false);
+    TEST_ASSERT_FALSE(coordinator->shouldOwn(SENSOR));
+    announce("gw-c", -65, false);
+    TEST_ASSERT_TRUE(coordinator->shouldOwn(SENSOR));
+}
+
+void test_equal_rssi_goes_to_lower_gateway_id() {
+    startUp();
+    coordinator->observe(SENSOR, -60);
+    announce("gw-a", -60, false);
+    TEST_ASSERT_FALSE(coordinator->shouldOwn(SENSOR));
+    announce("gw-a", -61, false);
+    announce("gw-c", -60, false);
+    TEST_ASSERT_TRUE(coordinator->shouldOwn(SENSOR));
+}
+
+void test_owned_sensor_moves_only_past_hysteresis() {
+    startUp();
+    coordinator->observe(SENSOR, -60);
+    announce("gw-c", -60 - OWNERSHIP_HYSTERESIS_DB + 1, true);
+    TEST_ASSERT_FALSE(coordinator->shouldOwn(SENSOR));
+    announce("gw-c", -60 - OWNERSHIP_HYSTERESIS_DB, true);
+    TEST_ASSERT_TRUE(coordinator->shouldOwn(SENSOR));
+}
+
+void test_owner_lets_go_for_better_gateway() {
+    startUp();
+    coordinator->observe(SENSOR, -70);
+    coordinator->setOwned(SENSOR, true);
+    announce("gw-c", -70 + OWNERSHIP_HYSTERESIS_DB - 1, false);
+    TEST_ASSERT_TRUE(coordinator->shouldOwn(SENSOR));
+    // The better gateway can't connect while we hold the link, so we have to disconnect first
+    announce("gw-c", -70 + OWNERSHIP_HYSTERESIS_DB, false);
+    TEST_ASSERT_FALSE(coordinator->shouldOwn(SENSOR));
+}
+
+void test_double_claim_is_settled_by_rssi_then_id() {
+    startUp();
+    coordinator->observe(SENSOR, -60);
+    coordinator->setOwned(SENSOR, true);
+    announce("gw-c", -60, true);
+    TEST_ASSERT_TRUE(coordinator->shouldOwn(SENSOR));
+    announce("gw-a", -60, true);
+    TEST_ASSERT_FALSE(coordinator->shouldOwn(SENSOR));
+}
+
+void test_silent_gateway_loses_its_claims() {
+    startUp();
+    coordinator->observe(SENSOR, -70);
+    announce("gw-c", -50, true);
+    TEST_ASSERT_FALSE(coordinator->shouldOwn(SENSOR));
+    advanceMillis(GATEWAY_TIMEOUT_MS);
+    coordinator->observe(SENSOR, -70);
+    TEST_ASSERT_TRUE(coordinator->shouldOwn(SENSOR));
+}
+
+void test_ignores_own_and_malformed_announcements() {
+    startUp();
+    coordinator->observe(SENSOR, -60);
+    announce("gw-b", -40, true);
+    coordinator->receive("SHGW1\nc0:de:00:00:00:01 -40 1\n");
+    coordinator->receive("HELLO gw-c\nc0:de:00:00:00:01 -40 1\n");
+    TEST_ASSERT_TRUE(coordinator->shouldOwn(SENSOR));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_waits_for_other_gateways_after_start);
+    RUN_TEST(test_unknown_or_unheard_sensor_is_not_claimed);
+    RUN_TEST(test_unowned_sensor_goes_to_strongest_gateway);
+    RUN_TEST(test_equal_rssi_goes_to_lower_gateway_id);
+    RUN_TEST(test_owned_sensor_moves_only_past_hysteresis);
+    RUN_TEST(test_owner_lets_go_for_better_gateway);
+    RUN_TEST(test_double_claim_is_settled_by_rssi_then_id);
+    RUN_TEST(test_silent_gateway_loses_its_claims);
+    RUN_TEST(test_ignores_own_and_malformed_announcements);
+    return UNITY_END();
+}
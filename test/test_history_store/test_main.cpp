@@ -0,0 +1,217 @@
+// Gorilla codec of HistoryStore: samples come back bit-exact through HistoryCursor, including after
+// the arena wraps around and recycles the oldest blocks, and HistoryDownsampler folds them into buckets
+#include <Arduino.h>
+#include <unity.h>
+
+// A handful of blocks, so the arena wraps after a few hundred samples
+#define HISTORY_ARENA_BYTES (8 * 272)
+#define HISTORY_MAX_SENSORS 4
+#include "HistoryStore.h"
+
+static_assert(sizeof(HistoryBlock) == 272, "HISTORY_ARENA_BYTES above assumes 272 byte blocks");
+
+static const char SENSOR[] = "c0:de:00:00:00:01";
+static const uint32_t START = 1700000000;
+static const int MAX_SAMPLES = 4000;
+
+static HistoryStore* store = nullptr;
+static uint32_t timestamps[MAX_SAMPLES];
+static float values[MAX_SAMPLES];
+static uint32_t randomState = 1;
+
+static uint32_t nextRandom() {
+    randomState = randomState * 1664525 + 1013904223;
+    return randomState >> 8;
+}
+
+// Mostly regular intervals with jitter and the occasional gap, values that drift or jump
+static int recordSamples(int count, uint32_t start) {
+    uint32_t timestamp = start;
+    float value = 21.5f;
+    for (int i = 0; i < count; i++) {
+        uint32_t roll = nextRandom() % 100;
+        if (roll < 5) {
+            timestamp += 3000 + nextRandom() % 100000; // outage, beyond the 12 bit delta-of-delta
+        } else if (roll < 20) {
+            timestamp += HISTORY_SAMPLE_INTERVAL_S + nextRandom() % 300;
+        } else {
+            timestamp += HISTORY_SAMPLE_INTERVAL_S;
+        }
+        roll = nextRandom() % 100;
+        if (roll < 10) {
+            value = (float)(nextRandom() % 200000) / 7.0f - 10000.0f;
+        } else if (roll < 60) {
+            value += (float)((int)(nextRandom() % 21) - 10) / 100.0f;
+        }
+        timestamps[i] = timestamp;
+        values[i] = value;
+        store->record(SENSOR, HISTORY_TEMPERATURE, value, timestamp);
+    }
+    return count;
+}
+
+// Checks the cursor returns exactly the samples from `first` on, with bit-identical values
+static void assertReadsBack(int first, int count, uint32_t from, uint32_t to) {
+    HistoryCursor cursor = store->cursor(store->findSensor(SENSOR), HISTORY_TEMPERATURE, from, to);
+    uint32_t timestamp;
+    float value;
+    for (int i = first; i < count; i++) {
+        TEST_ASSERT_TRUE(cursor.next(timestamp, value));
+        TEST_ASSERT_EQUAL_UINT32(timestamps[i], timestamp);
+        TEST_ASSERT_EQUAL_UINT32(historyFloatBits(values[i]), historyFloatBits(value));
+    }
+    TEST_ASSERT_FALSE(cursor.next(timestamp, value));
+}
+
+void setUp() {
+    randomState = 1;
+    store = new HistoryStore();
+    TEST_ASSERT_TRUE(store->setup());
+    TEST_ASSERT_EQUAL(8, store->getBlockCount());
+}
+
+void tearDown() {
+    delete store;
+    store = nullptr;
+}
+
+void test_roundtrip_within_arena() {
+    int count = recordSamples(150, START);
+    TEST_ASSERT_TRUE(store->getUsedBlocks() < store->getBlockCount());
+    assertReadsBack(0, count, 0, UINT32_MAX);
+}
+
+void test_roundtrip_after_wraparound() {
+    int count = recordSamples(MAX_SAMPLES, START);
+    TEST_ASSERT_EQUAL(store->getBlockCount(), store->getUsedBlocks());
+
+    // The oldest blocks were recycled, what's left is a contiguous tail ending at the newest sample
+    HistoryCursor cursor = store->cursor(store->findSensor(SENSOR), HISTORY_TEMPERATURE, 0, UINT32_MAX);
+    uint32_t oldest;
+    float value;
+    TEST_ASSERT_TRUE(cursor.next(oldest, value));
+    int first = 0;
+    while (timestamps[first] != oldest) {
+        first++;
+    }
+    TEST_ASSERT_TRUE(first > 0);
+    assertReadsBack(first, count, 0, UINT32_MAX);
+}
+
+void test_time_range_is_inclusive() {
+    int count = recordSamples(150, START);
+    int first = 40;
+    int last = 90;
+    HistoryCursor cursor = store->cursor(store->findSensor(SENSOR), HISTORY_TEMPERATURE, timestamps[first], timestamps[last]);
+    uint32_t timestamp;
+    float value;
+    for (int i = first; i <= last; i++) {
+        TEST_ASSERT_TRUE(cursor.next(timestamp, value));
+        TEST_ASSERT_EQUAL_UINT32(timestamps[i], timestamp);
+    }
+    TEST_ASSERT_FALSE(cursor.next(timestamp, value));
+    TEST_ASSERT_TRUE(last < count);
+}
+
+void test_interleaved_series_share_the_arena() {
+    float humidity[MAX_SAMPLES];
+    for (int i = 0; i < 600; i++) {
+        timestamps[i] = START + i * HISTORY_SAMPLE_INTERVAL_S;
+        values[i] = 20.0f + (float)(nextRandom() % 1000) / 100.0f;
+        humidity[i] = 40.0f + (float)(nextRandom() % 1000) / 100.0f;
+        store->record(SENSOR, HISTORY_TEMPERATURE, values[i], timestamps[i]);
+        store->record(SENSOR, HISTORY_HUMIDITY, humidity[i], timestamps[i]);
+    }
+    int sensor = store->findSensor(SENSOR);
+    HistoryQuantity quantities[] = {HISTORY_TEMPERATURE, HISTORY_HUMIDITY};
+    const float* expected[] = {values, humidity};
+    for (int q = 0; q < 2; q++) {
+        HistoryCursor cursor = store->cursor(sensor, quantities[q], 0, UINT32_MAX);
+        uint32_t timestamp;
+        float value;
+        TEST_ASSERT_TRUE(cursor.next(timestamp, value));
+        int i = (timestamp - START) / HISTORY_SAMPLE_INTERVAL_S;
+        TEST_ASSERT_TRUE(i > 0);
+        do {
+            TEST_ASSERT_EQUAL_UINT32(timestamps[i], timestamp);
+            TEST_ASSERT_EQUAL_UINT32(historyFloatBits(expected[q][i]), historyFloatBits(value));
+            i++;
+        } while (cursor.next(timestamp, value));
+        TEST_ASSERT_EQUAL(600, i);
+    }
+}
+
+void test_drops_non_finite_and_out_of_order_samples() {
+    store->record(SENSOR, HISTORY_TEMPERATURE, 20.0f, START);
+    store->record(SENSOR, HISTORY_TEMPERATURE, NAN, START + 60);
+    store->record(SENSOR, HISTORY_TEMPERATURE, INFINITY, START + 120);
+    store->record(SENSOR, HISTORY_TEMPERATURE, -INFINITY, START + 180);
+    store->record(SENSOR, HISTORY_TEMPERATURE, 21.0f, START);
+    store->record(SENSOR, HISTORY_TEMPERATURE, 22.0f, START + 240);
+
+    HistoryCursor cursor = store->cursor(store->findSensor(SENSOR), HISTORY_TEMPERATURE, 0, UINT32_MAX);
+    uint32_t timestamp;
+    float value;
+    TEST_ASSERT_TRUE(cursor.next(timestamp, value));
+    TEST_ASSERT_EQUAL_UINT32(START, timestamp);
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, value);
+    TEST_ASSERT_TRUE(cursor.next(timestamp, value));
+    TEST_ASSERT_EQUAL_UINT32(START + 240, timestamp);
+    TEST_ASSERT_EQUAL_FLOAT(22.0f, value);
+    TEST_ASSERT_FALSE(cursor.next(timestamp, value));
+}
+
+void test_quietest_sensor_is_replaced_when_full() {
+    char address[HISTORY_ADDRESS_LENGTH];
+    for (int i = 0; i <= HISTORY_MAX_SENSORS; i++) {
+        snprintf(address, sizeof(address), "c0:de:00:00:01:%02x", i);
+        store->record(address, HISTORY_TEMPERATURE, 20.0f + i, START + i);
+    }
+    TEST_ASSERT_EQUAL(-1, store->findSensor("c0:de:00:00:01:00"));
+    int sensor = store->findSensor(address);
+    TEST_ASSERT_TRUE(sensor >= 0);
+
+    HistoryCursor cursor = store->cursor(sensor, HISTORY_TEMPERATURE, 0, UINT32_MAX);
+    uint32_t timestamp;
+    float value;
+    TEST_ASSERT_TRUE(cursor.next(timestamp, value));
+    TEST_ASSERT_EQUAL_UINT32(START + HISTORY_MAX_SENSORS, timestamp);
+    TEST_ASSERT_FALSE(cursor.next(timestamp, value));
+}
+
+void test_downsampler_buckets() {
+    float samples[] = {1.0f, 3.0f, 2.0f, 10.0f, 20.0f};
+    uint32_t offsets[] = {0, 60, 120, 240, 300};
+    for (int i = 0; i < 5; i++) {
+        store->record(SENSOR, HISTORY_CO2, samples[i], START + offsets[i]);
+    }
+    HistoryCursor cursor = store->cursor(store->findSensor(SENSOR), HISTORY_CO2, START, START + 3600);
+    HistoryDownsampler downsampler(cursor, START, 180);
+    HistoryBucket bucket;
+
+    TEST_ASSERT_TRUE(downsampler.next(bucket));
+    TEST_ASSERT_EQUAL_UINT32(START, bucket.start);
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, bucket.average);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, bucket.minimum);
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, bucket.maximum);
+
+    TEST_ASSERT_TRUE(downsampler.next(bucket));
+    TEST_ASSERT_EQUAL_UINT32(START + 180, bucket.start);
+    TEST_ASSERT_EQUAL_FLOAT(15.0f, bucket.average);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, bucket.minimum);
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, bucket.maximum);
+
+    TEST_ASSERT_FALSE(downsampler.next(bucket));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_roundtrip_within_arena);
+    RUN_TEST(test_roundtrip_after_wraparound);
+    RUN_TEST(test_time_range_is_inclusive);
+    RUN_TEST(test_interleaved_series_share_the_arena);
+    RUN_TEST(test_drops_non_finite_and_out_of_order_samples);
+    RUN_TEST(test_quietest_sensor_is_replaced_when_full);
+    RUN_TEST(test_downsampler_buckets);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+// Queueing rules of OutputSinks against a scripted sink: readings leave the queue only once flushed,
+// refused or oversized ones are dropped and counted, a full batch is flushed without failing and a failed batch
+// is resent whole after the backoff
+#include <Arduino.h>
+#include <unity.h>
+
+#include "OutputSink.h"
+
+static const int MAX_WRITES = 64;
+
+class ScriptedSink : public OutputSink {
+public:
+    bool connected = true;
+    bool flushSucceeds = true;
+    size_t batchSize = 4;
+    size_t bufferCapacity = 100; // readings before write() answers SINK_WRITE_FULL
+    int rejectTimestamp = -1;    // the reading with this timestamp is refused
+    int failTimestamp = -1;      // the sink goes down on the reading with this timestamp
+    int oversizeTimestamp = -1;  // the reading with this timestamp doesn't fit even an empty buffer
+    size_t buffered = 0;
+    uint32_t sent[MAX_WRITES];
+    int sentCount = 0;
+    uint32_t pending[MAX_WRITES];
+
+    const char* getName() const override {
+        return "Scripted";
+    }
+
+    bool connect() override {
+        return connected;
+    }
+
+    bool isConnected() override {
+        return connected;
+    }
+
+    SinkWriteResult write(const SensorReading& reading) override {
+        if ((int)reading.timestamp == failTimestamp) {
+            buffered = 0;
+            return SINK_WRITE_FAILED;
+        }
+        if ((int)reading.timestamp == rejectTimestamp) {
+            return SINK_WRITE_REJECTED;
+        }
+        if (buffered == bufferCapacity || (int)reading.timestamp == oversizeTimestamp) {
+            return SINK_WRITE_FULL;
+        }
+        pending[buffered++] = reading.timestamp;
+        return SINK_WRITE_OK;
+    }
+
+    bool flush() override {
+        if (flushSucceeds) {
+            for (size_t i = 0; i < buffered; i++) {
+                sent[sentCount++] = pending[i];
+            }
+        }
+        buffered = 0;
+        return flushSucceeds;
+    }
+
+    size_t getBatchSize() const override {
+        return batchSize;
+    }
+};
+
+static OutputSinks* sinks = nullptr;
+static ScriptedSink* sink = nullptr;
+
+static void publish(uint32_t first, uint32_t last) {
+    for (uint32_t timestamp = first; timestamp <= last; timestamp++) {
+        SensorReading reading;
+        snprintf(reading.deviceId, sizeof(reading.deviceId), "c0:de:00:00:00:%02x", (unsigned)timestamp);
+        reading.timestamp = timestamp;
+        sinks->publish(reading);
+    }
+}
+
+static void assertSent(const uint32_t* expected, int count) {
+    TEST_ASSERT_EQUAL(count, sink->sentCount);
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT32(expected[i], sink->sent[i]);
+    }
+}
+
+void setUp() {
+    sinks = new OutputSinks();
+    sink = new ScriptedSink();
+    TEST_ASSERT_TRUE(sinks->add(*sink));
+}
+
+void tearDown() {
+    delete sinks;
+    delete sink;
+    sinks = nullptr;
+    sink = nullptr;
+}
+
+void test_delivers_in_batches() {
+    publish(1, 6);
+    sinks->loop();
+    TEST_ASSERT_EQUAL(4, sink->sentCount);
+    sinks->loop();
+    uint32_t expected[] = {1, 2, 3, 4, 5, 6};
+    assertSent(expected, 6);
+    TEST_ASSERT_EQUAL(0, sinks->getState(0).count);
+    TEST_ASSERT_EQUAL(6, sinks->getState(0).delivered);
+}
+
+void test_rejected_reading_is_dropped_and_counted() {
+    sink->rejectTimestamp = 2;
+    publish(1, 4);
+    sinks->loop();
+    sinks->loop();
+    uint32_t expected[] = {1, 3, 4};
+    assertSent(expected, 3);
+    const OutputSinkState& state = sinks->getState(0);
+    TEST_ASSERT_EQUAL(0, state.count);
+    TEST_ASSERT_EQUAL(3, state.delivered);
+    TEST_ASSERT_EQUAL(1, state.rejected);
+    TEST_ASSERT_EQUAL(0, state.failures);
+}
+
+void test_full_buffer_ends_the_batch_without_failing() {
+    sink->bufferCapacity = 3;
+    publish(1, 4);
+    sinks->loop();
+    TEST_ASSERT_EQUAL(3, sink->sentCount);
+    TEST_ASSERT_EQUAL(1, sinks->getState(0).count);
+    TEST_ASSERT_EQUAL(0, sinks->getState(0).failures);
+    sinks->loop();
+    uint32_t expected[] = {1, 2, 3, 4};
+    assertSent(expected, 4);
+}
+
+void test_reading_too_big_for_a_batch_is_dropped_and_counted() {
+    sink->oversizeTimestamp = 3;
+    publish(1, 5);
+    sinks->loop();
+    sinks->loop();
+    sinks->loop();
+    uint32_t expected[] = {1, 2, 4, 5};
+    assertSent(expected, 4);
+    const OutputSinkState& state = sinks->getState(0);
+    TEST_ASSERT_EQUAL(0, state.count);
+    TEST_ASSERT_EQUAL(4, state.delivered);
+    TEST_ASSERT_EQUAL(1, state.rejected);
+    TEST_ASSERT_EQUAL(0, state.failures);
+}
+
+void test_failed_flush_resends_the_batch_after_backoff() {
+    sink->flushSucceeds = false;
+    publish(1, 3);
+    sinks->loop();
+    TEST_ASSERT_EQUAL(0, sink->sentCount);
+    TEST_ASSERT_EQUAL(3, sinks->getState(0).count);
+    TEST_ASSERT_EQUAL(1, sinks->getState(0).failures);
+
+    sink->flushSucceeds = true;
+    sinks->loop();
+    TEST_ASSERT_EQUAL(0, sink->sentCount); // still backing off
+    advanceMillis(SINK_MIN_BACKOFF_MS);
+    sinks->loop();
+    uint32_t expected[] = {1, 2, 3};
+    assertSent(expected, 3);
+    TEST_ASSERT_EQUAL(0, sinks->getState(0).failures);
+}
+
+void test_failed_write_keeps_the_batch_queued() {
+    sink->failTimestamp = 3;
+    publish(1, 4);
+    sinks->loop();
+    TEST_ASSERT_EQUAL(0, sink->sentCount);
+    TEST_ASSERT_EQUAL(4, sinks->getState(0).count);
+    TEST_ASSERT_EQUAL(0, sinks->getState(0).rejected);
+}
+
+void test_full_queue_drops_oldest() {
+    sink->connected = false;
+    publish(1, OUTPUT_SINK_QUEUE_LENGTH + 2);
+    const OutputSinkState& state = sinks->getState(0);
+    TEST_ASSERT_EQUAL(OUTPUT_SINK_QUEUE_LENGTH, state.count);
+    TEST_ASSERT_EQUAL(2, state.dropped);
+    TEST_ASSERT_EQUAL_UINT32(3, state.queue[state.head].timestamp);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_delivers_in_batches);
+    RUN_TEST(test_rejected_reading_is_dropped_and_counted);
+    RUN_TEST(test_full_buffer_ends_the_batch_without_failing);
+    RUN_TEST(test_reading_too_big_for_a_batch_is_dropped_and_counted);
+    RUN_TEST(test_failed_flush_resends_the_batch_after_backoff);
+    RUN_TEST(test_failed_write_keeps_the_batch_queued);
+    RUN_TEST(test_full_queue_drops_oldest);
+    return UNITY_END();
+}